@@ -87,11 +87,21 @@
     /// only available with newer glibc
 #define pthread_setname_np(thread, name)
 #endif
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#endif
+
+#ifdef USE_SWRESAMPLE
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
 #endif
 
 #include "iatomic.h"			// portable atomic_t
 
 #include "ringbuffer.h"
+#include "audiodsp.h"
 #include "misc.h"
 #include "audio.h"
 #include "video.h"
@@ -152,10 +162,12 @@ static int AudioBufferTime;	///< audio buffer time in ms
 #ifdef USE_AUDIO_THREAD
 static pthread_t AudioThread;		///< audio play thread
 static pthread_mutex_t AudioMutex;	///< audio condition mutex
-pthread_mutex_t PTS_mutex;		///< PTS mutex
 pthread_mutex_t ReadAdvance_mutex;	///< PTS mutex
 pthread_cond_t AudioStartCond;		///< condition variable
 static char AudioThreadStop;		///< stop audio thread
+static int AudioEventFd = -1;		///< wakeup play thread
+static atomic_t AudioThreadIdle;	///< play thread waits for samples
+static atomic_t AudioWakeups;		///< play thread wakeup counter
 #else
 static const int AudioThread;		///< dummy audio thread
 #endif
@@ -218,7 +230,9 @@ static const unsigned AudioRatesTable[AudioRatesMax] = {
 //	filter
 //----------------------------------------------------------------------------
 
-static const int AudioNormSamples = 4096;	///< number of samples
+#define AudioNormShift AUDIO_DSP_SHIFT	///< log2 of AudioNormSamples
+    /// number of samples
+static const int AudioNormSamples = 1 << AudioNormShift;
 
 #define AudioNormMaxIndex 128		///< number of average values
     /// average of n last sample blocks
@@ -227,6 +241,47 @@ static int AudioNormIndex;		///< index into average table
 static int AudioNormReady;		///< index counter
 static int AudioNormCounter;		///< sample counter
 
+/**
+**	Finish a normalizer sample block and update the normalize factor.
+*/
+static void AudioNormalizerBlock(void)
+{
+    int i;
+    uint32_t avg;
+    int factor;
+
+    if (AudioNormReady < AudioNormMaxIndex) {
+	AudioNormReady++;
+    } else {
+	avg = 0;
+	for (i = 0; i < AudioNormMaxIndex; ++i) {
+	    avg += AudioNormAverage[i] / AudioNormMaxIndex;
+	}
+
+	// calculate normalize factor
+	if (avg > 0) {
+	    factor = ((INT16_MAX / 8) * 1000U) / (uint32_t) sqrt(avg);
+	    // smooth normalize
+	    AudioNormalizeFactor =
+		(AudioNormalizeFactor * 500 + factor * 500) / 1000;
+	    if (AudioNormalizeFactor < AudioMinNormalize) {
+		AudioNormalizeFactor = AudioMinNormalize;
+	    }
+	    if (AudioNormalizeFactor > AudioMaxNormalize) {
+		AudioNormalizeFactor = AudioMaxNormalize;
+	    }
+	} else {
+	    factor = 1000;
+	}
+	Debug(4, "audio/noramlize: avg %8d, fac=%6.3f, norm=%6.3f\n", avg,
+	    factor / 1000.0, AudioNormalizeFactor / 1000.0);
+    }
+
+    AudioNormIndex = (AudioNormIndex + 1) % AudioNormMaxIndex;
+    AudioNormCounter = 0;
+    AudioNormAverage[AudioNormIndex] = 0U;
+}
+
 /**
 **	Audio normalizer.
 **
@@ -235,11 +290,8 @@ static int AudioNormCounter;		///< sample counter
 */
 static void AudioNormalizer(int16_t * samples, int count)
 {
-    int i;
     int l;
     int n;
-    uint32_t avg;
-    int factor;
     int16_t *data;
 
     // average samples
@@ -250,63 +302,18 @@ static void AudioNormalizer(int16_t * samples, int count)
 	if (AudioNormCounter + n > AudioNormSamples) {
 	    n = AudioNormSamples - AudioNormCounter;
 	}
-	avg = AudioNormAverage[AudioNormIndex];
-	for (i = 0; i < n; ++i) {
-	    int t;
-
-	    t = data[i];
-	    avg += (t * t) / AudioNormSamples;
-	}
-	AudioNormAverage[AudioNormIndex] = avg;
+	AudioNormAverage[AudioNormIndex] += AudioDspSumSquares(data, n);
 	AudioNormCounter += n;
 	if (AudioNormCounter >= AudioNormSamples) {
-	    if (AudioNormReady < AudioNormMaxIndex) {
-		AudioNormReady++;
-	    } else {
-		avg = 0;
-		for (i = 0; i < AudioNormMaxIndex; ++i) {
-		    avg += AudioNormAverage[i] / AudioNormMaxIndex;
-		}
-
-		// calculate normalize factor
-		if (avg > 0) {
-		    factor = ((INT16_MAX / 8) * 1000U) / (uint32_t) sqrt(avg);
-		    // smooth normalize
-		    AudioNormalizeFactor =
-			(AudioNormalizeFactor * 500 + factor * 500) / 1000;
-		    if (AudioNormalizeFactor < AudioMinNormalize) {
-			AudioNormalizeFactor = AudioMinNormalize;
-		    }
-		    if (AudioNormalizeFactor > AudioMaxNormalize) {
-			AudioNormalizeFactor = AudioMaxNormalize;
-		    }
-		} else {
-		    factor = 1000;
-		}
-		Debug(4, "audio/noramlize: avg %8d, fac=%6.3f, norm=%6.3f\n",
-		    avg, factor / 1000.0, AudioNormalizeFactor / 1000.0);
-	    }
-
-	    AudioNormIndex = (AudioNormIndex + 1) % AudioNormMaxIndex;
-	    AudioNormCounter = 0;
-	    AudioNormAverage[AudioNormIndex] = 0U;
+	    AudioNormalizerBlock();
 	}
 	data += n;
 	l -= n;
     } while (l > 0);
 
     // apply normalize factor
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-	int t;
-
-	t = (samples[i] * AudioNormalizeFactor) / 1000;
-	if (t < INT16_MIN) {
-	    t = INT16_MIN;
-	} else if (t > INT16_MAX) {
-	    t = INT16_MAX;
-	}
-	samples[i] = t;
-    }
+    AudioDspScale(samples, count / AudioBytesProSample,
+	AudioNormalizeFactor);
 }
 
 /**
@@ -325,59 +332,52 @@ static void AudioResetNormalizer(void)
 }
 
 /**
-**	Audio compression.
+**	Update compression factor from the loudest sample.
 **
-**	@param samples	sample buffer
-**	@param count	number of bytes in sample buffer
+**	@param max_sample	loudest sample of the block
+**
+**	@returns false for silent blocks, the factor isn't changed.
 */
-static void AudioCompressor(int16_t * samples, int count)
+static int AudioCompressorUpdate(int max_sample)
 {
-    int max_sample;
-    int i;
     int factor;
 
-    // find loudest sample
-    max_sample = 0;
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-	int t;
-
-	t = abs(samples[i]);
-	if (t > max_sample) {
-	    max_sample = t;
-	}
-    }
-
     // calculate compression factor
-    if (max_sample > 0) {
-	factor = (INT16_MAX * 1000) / max_sample;
-	// smooth compression (FIXME: make configurable?)
-	AudioCompressionFactor =
-	    (AudioCompressionFactor * 950 + factor * 50) / 1000;
-	if (AudioCompressionFactor > factor) {
-	    AudioCompressionFactor = factor;	// no clipping
-	}
-	if (AudioCompressionFactor > AudioMaxCompression) {
-	    AudioCompressionFactor = AudioMaxCompression;
-	}
-    } else {
-	return;				// silent nothing todo
+    if (max_sample <= 0) {
+	return 0;			// silent nothing todo
+    }
+    factor = (INT16_MAX * 1000) / max_sample;
+    // smooth compression (FIXME: make configurable?)
+    AudioCompressionFactor =
+	(AudioCompressionFactor * 950 + factor * 50) / 1000;
+    if (AudioCompressionFactor > factor) {
+	AudioCompressionFactor = factor;	// no clipping
+    }
+    if (AudioCompressionFactor > AudioMaxCompression) {
+	AudioCompressionFactor = AudioMaxCompression;
     }
 
     Debug(4, "audio/compress: max %5d, fac=%6.3f, com=%6.3f\n", max_sample,
 	factor / 1000.0, AudioCompressionFactor / 1000.0);
+    return 1;
+}
 
-    // apply compression factor
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-	int t;
-
-	t = (samples[i] * AudioCompressionFactor) / 1000;
-	if (t < INT16_MIN) {
-	    t = INT16_MIN;
-	} else if (t > INT16_MAX) {
-	    t = INT16_MAX;
-	}
-	samples[i] = t;
+/**
+**	Audio compression.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+*/
+static void AudioCompressor(int16_t * samples, int count)
+{
+    // find loudest sample
+    if (!AudioCompressorUpdate(AudioDspMaxAbs(samples,
+		count / AudioBytesProSample))) {
+	return;
     }
+    // apply compression factor
+    AudioDspScale(samples, count / AudioBytesProSample,
+	AudioCompressionFactor);
 }
 
 /**
@@ -401,25 +401,13 @@ static void AudioResetCompressor(void)
 */
 static void AudioSoftAmplifier(int16_t * samples, int count)
 {
-    int i;
-
     // silence
     if (AudioMute || !AudioAmplifier) {
 	memset(samples, 0, count);
 	return;
     }
 
-    for (i = 0; i < count / AudioBytesProSample; ++i) {
-	int t;
-
-	t = (samples[i] * AudioAmplifier) / 1000;
-	if (t < INT16_MIN) {
-	    t = INT16_MIN;
-	} else if (t > INT16_MAX) {
-	    t = INT16_MAX;
-	}
-	samples[i] = t;
-    }
+    AudioDspScale(samples, count / AudioBytesProSample, AudioAmplifier);
 }
 
 #ifdef USE_AUDIO_MIXER
@@ -658,6 +646,597 @@ static int AudioRingRead;		///< audio ring read pointer
 static atomic_t AudioRingFilled;	///< how many of the ring is used
 static unsigned AudioStartThreshold;	///< start play, if filled
 
+    /// PTS sequence counter, odd while PTS and ring fill are updated
+static atomic_t AudioPtsSeq;
+
+/**
+**	Begin update of write ring PTS and ring fill.
+**
+**	Only the decoder thread writes, readers retry (seqlock).
+*/
+static inline void AudioPtsWriteBegin(void)
+{
+    atomic_inc(&AudioPtsSeq);
+    atomic_release_fence();
+}
+
+/**
+**	End update of write ring PTS and ring fill.
+*/
+static inline void AudioPtsWriteEnd(void)
+{
+    atomic_release_fence();
+    atomic_inc(&AudioPtsSeq);
+}
+
+#ifdef USE_AUDIO_THREAD
+
+//----------------------------------------------------------------------------
+//	thread events
+//----------------------------------------------------------------------------
+
+/**
+**	Wakeup the play thread.
+**
+**	@param command	true for commands (flush, new ring, ...), false for
+**			new samples, which only wakeup the idle thread.
+*/
+static void AudioEventSignal(int command)
+{
+    uint64_t one;
+
+    if (AudioEventFd == -1) {
+	return;
+    }
+    if (!command) {
+	// samples are published before the idle flag is checked
+	atomic_fence();
+	if (!atomic_read(&AudioThreadIdle)) {
+	    return;
+	}
+    }
+    one = 1;
+    if (write(AudioEventFd, &one, sizeof(one)) != sizeof(one)) {
+	Debug(3, "audio: can't signal play thread: %s\n", strerror(errno));
+    }
+}
+
+/**
+**	Wait for output device and play thread events.
+**
+**	@param fds	poll descriptors, space for one more is needed
+**	@param n	number of device poll descriptors in @p fds
+**	@param timeout	timeout in ms
+**
+**	@returns number of ready device descriptors, 0 timeout or event only,
+**	-1 error.
+*/
+static int AudioPollEvents(struct pollfd *fds, int n, int timeout)
+{
+    int ret;
+
+    fds[n].fd = AudioEventFd;
+    fds[n].events = POLLIN;
+    fds[n].revents = 0;
+    ret = poll(fds, n + (AudioEventFd != -1), timeout);
+    atomic_inc(&AudioWakeups);
+    if (ret <= 0) {
+	return ret < 0 && errno != EINTR ? -1 : 0;
+    }
+    if (AudioEventFd != -1 && fds[n].revents & POLLIN) {
+	uint64_t cnt;
+
+	if (read(AudioEventFd, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+	    Debug(3, "audio: can't clear play thread event\n");
+	}
+	--ret;
+    }
+    return ret;
+}
+
+/**
+**	Wait until samples are enqueued or a command arrives.
+**
+**	@param timeout	timeout in ms
+*/
+static void AudioWaitEvent(int timeout)
+{
+    struct pollfd fds[1];
+
+    atomic_set(&AudioThreadIdle, 1);
+    // recheck after the idle flag is visible to the writer
+    if (!RingBufferUsedBytes(AudioRing[AudioRingRead].RingBuffer)
+	&& !atomic_read(&AudioRingFilled) && !AudioThreadStop
+	&& !AudioPaused) {
+	AudioPollEvents(fds, 0, timeout);
+    }
+    atomic_set(&AudioThreadIdle, 0);
+}
+
+#endif
+
+#ifdef USE_SWRESAMPLE
+
+//----------------------------------------------------------------------------
+//	float pipeline
+//----------------------------------------------------------------------------
+
+static SwrContext *AudioSwr;		///< s16 -> planar float converter
+static int AudioSwrRing = -1;		///< ring slot converter is setup for
+static unsigned AudioSwrInRate;		///< converter input sample rate
+static unsigned AudioSwrInChannels;	///< converter input channels
+static unsigned AudioSwrHwRate;		///< converter output sample rate
+static unsigned AudioSwrHwChannels;	///< converter output channels
+static float *AudioSwrBuffer;		///< planar float samples
+static int AudioSwrFrames;		///< frames space of each plane
+
+    /// speaker positions, to build the mix matrix
+enum _audio_speaker_
+{
+    AudioSpeakerL,			///< front left
+    AudioSpeakerR,			///< front right
+    AudioSpeakerLs,			///< surround left
+    AudioSpeakerRs,			///< surround right
+    AudioSpeakerC,			///< center
+    AudioSpeakerLfe,			///< low frequency effects
+    AudioSpeakerRl,			///< rear left
+    AudioSpeakerRr,			///< rear right
+    AudioSpeakerMono,			///< mono
+};
+
+    /// alsa speaker order of the samples for 1-8 channels
+static const signed char AudioSpeakerTable[9][8] = {
+    {-1},
+    {AudioSpeakerMono},
+    {AudioSpeakerL, AudioSpeakerR},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerC},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerLs, AudioSpeakerRs},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerLs, AudioSpeakerRs,
+	AudioSpeakerC},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerLs, AudioSpeakerRs,
+	AudioSpeakerC, AudioSpeakerLfe},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerLs, AudioSpeakerRs,
+	AudioSpeakerC, AudioSpeakerRl, AudioSpeakerRr},
+    {AudioSpeakerL, AudioSpeakerR, AudioSpeakerLs, AudioSpeakerRs,
+	AudioSpeakerC, AudioSpeakerLfe, AudioSpeakerRl, AudioSpeakerRr},
+};
+
+    /// stereo downmix weight /1000 (same as AudioSurround2Stereo)
+static const short AudioStereoDownmix[9][8] = {
+    {0},
+    {1000},
+    {1000, 1000},
+    {600, 600, 400},
+    {600, 600, 400, 400},
+    {500, 500, 200, 200, 300},
+    {400, 400, 200, 200, 300, 100},
+    {400, 400, 200, 200, 300, 100, 100},
+    {400, 400, 150, 150, 250, 100, 100, 100},
+};
+
+/**
+**	Find channel of speaker.
+**
+**	@param channels	number of channels
+**	@param speaker	speaker position
+**
+**	@returns channel index or -1 if there is no such speaker.
+*/
+static int AudioSpeakerChannel(int channels, int speaker)
+{
+    int i;
+
+    for (i = 0; i < channels; ++i) {
+	if (AudioSpeakerTable[channels][i] == speaker) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/**
+**	Build mix matrix for @a in_chan to @a out_chan channels.
+**
+**	Stereo and mono use the old downmix weights, all other layouts map
+**	the speakers 1:1 and fold missing speakers into the nearest ones.
+**
+**	@param in_chan	nr. of input channels
+**	@param out_chan	nr. of output channels
+**	@param[out] matrix	out_chan * in_chan weights
+*/
+static void AudioMixMatrix(int in_chan, int out_chan, double *matrix)
+{
+    int i;
+    int o;
+
+    // mono is calculated from the stereo weights
+    memset(matrix, 0, (out_chan < 2 ? 2 : out_chan) * in_chan * sizeof(*matrix));
+    if (out_chan <= 2) {
+	for (i = 0; i < in_chan; ++i) {
+	    double w;
+
+	    w = AudioStereoDownmix[in_chan][i] / 1000.0;
+	    switch (AudioSpeakerTable[in_chan][i]) {
+		case AudioSpeakerL:
+		case AudioSpeakerLs:
+		case AudioSpeakerRl:
+		    matrix[i] = w;
+		    break;
+		case AudioSpeakerR:
+		case AudioSpeakerRs:
+		case AudioSpeakerRr:
+		    matrix[in_chan + i] = w;
+		    break;
+		default:
+		    matrix[i] = w;
+		    matrix[in_chan + i] = w;
+		    break;
+	    }
+	}
+	if (out_chan == 1) {		// mono is average of stereo
+	    for (i = 0; i < in_chan; ++i) {
+		matrix[i] = (matrix[i] + matrix[in_chan + i]) / 2;
+	    }
+	}
+	return;
+    }
+
+    for (i = 0; i < in_chan; ++i) {
+	int speaker;
+
+	speaker = AudioSpeakerTable[in_chan][i];
+	if ((o = AudioSpeakerChannel(out_chan, speaker)) >= 0) {
+	    matrix[o * in_chan + i] = 1.0;
+	    continue;
+	}
+	switch (speaker) {
+	    case AudioSpeakerRl:	// rear into surround or front
+	    case AudioSpeakerRr:
+		o = AudioSpeakerChannel(out_chan,
+		    speaker == AudioSpeakerRl ? AudioSpeakerLs : AudioSpeakerRs);
+		if (o >= 0) {
+		    matrix[o * in_chan + i] = M_SQRT1_2;
+		    break;
+		}
+		matrix[(speaker == AudioSpeakerRr) * in_chan + i] = M_SQRT1_2;
+		break;
+	    case AudioSpeakerLs:	// surround into front
+		matrix[i] = M_SQRT1_2;
+		break;
+	    case AudioSpeakerRs:
+		matrix[in_chan + i] = M_SQRT1_2;
+		break;
+	    case AudioSpeakerC:	// center into both fronts
+		matrix[i] = M_SQRT1_2;
+		matrix[in_chan + i] = M_SQRT1_2;
+		break;
+	    case AudioSpeakerMono:
+		matrix[i] = 1.0;
+		matrix[in_chan + i] = 1.0;
+		break;
+	    default:			// LFE is dropped
+		break;
+	}
+    }
+}
+
+/**
+**	Setup float converter for the current write ring.
+**
+**	@returns false, if the ring can't use the float pipeline.
+*/
+static int AudioSwrSetup(void)
+{
+    const AudioRingRing *ring;
+    double matrix[8 * 8];
+    int err;
+
+#if LIBSWRESAMPLE_VERSION_INT >= AV_VERSION_INT(4,5,100)
+    AVChannelLayout in_layout;
+    AVChannelLayout out_layout;
+#endif
+
+    ring = &AudioRing[AudioRingWrite];
+    if (AudioSwr && AudioSwrRing == AudioRingWrite
+	&& AudioSwrInRate == ring->InSampleRate
+	&& AudioSwrInChannels == ring->InChannels
+	&& AudioSwrHwRate == ring->HwSampleRate
+	&& AudioSwrHwChannels == ring->HwChannels) {
+	return 1;
+    }
+    // new ring, drop old converter and its delayed samples
+    swr_free(&AudioSwr);
+    AudioSwrRing = AudioRingWrite;
+    AudioSwrInRate = ring->InSampleRate;
+    AudioSwrInChannels = ring->InChannels;
+    AudioSwrHwRate = ring->HwSampleRate;
+    AudioSwrHwChannels = ring->HwChannels;
+
+#if LIBSWRESAMPLE_VERSION_INT < AV_VERSION_INT(4,5,100)
+    AudioSwr =
+	swr_alloc_set_opts(NULL,
+	av_get_default_channel_layout(ring->HwChannels), AV_SAMPLE_FMT_FLTP,
+	ring->HwSampleRate, av_get_default_channel_layout(ring->InChannels),
+	AV_SAMPLE_FMT_S16, ring->InSampleRate, 0, NULL);
+    err = AudioSwr ? 0 : AVERROR(ENOMEM);
+#else
+    av_channel_layout_default(&in_layout, ring->InChannels);
+    av_channel_layout_default(&out_layout, ring->HwChannels);
+    err =
+	swr_alloc_set_opts2(&AudioSwr, &out_layout, AV_SAMPLE_FMT_FLTP,
+	ring->HwSampleRate, &in_layout, AV_SAMPLE_FMT_S16, ring->InSampleRate,
+	0, NULL);
+    av_channel_layout_uninit(&in_layout);
+    av_channel_layout_uninit(&out_layout);
+#endif
+    if (!err) {
+	// samples are in alsa order, remix with our own matrix
+	AudioMixMatrix(ring->InChannels, ring->HwChannels, matrix);
+	err = swr_set_matrix(AudioSwr, matrix, ring->InChannels);
+    }
+    if (!err) {
+	err = swr_init(AudioSwr);
+    }
+    if (err < 0) {
+	Error(_("audio: can't setup float pipeline %dHz*%d -> %dHz*%d\n"),
+	    ring->InSampleRate, ring->InChannels, ring->HwSampleRate,
+	    ring->HwChannels);
+	swr_free(&AudioSwr);
+	return 0;
+    }
+    Debug(3, "audio: float pipeline %dHz*%d -> %dHz*%d\n",
+	ring->InSampleRate, ring->InChannels, ring->HwSampleRate,
+	ring->HwChannels);
+    return 1;
+}
+
+/**
+**	Compress and normalize planar float samples.
+**
+**	Only the statistics are collected here, the gain is applied by
+**	AudioSwrRender without clipping between the stages.
+**
+**	@param planes	sample planes
+**	@param channels	number of planes
+**	@param frames	number of samples in each plane
+**
+**	@returns gain to apply to the samples.
+*/
+static float AudioSwrFilter(float *const *planes, int channels, int frames)
+{
+    float gain;
+    int c;
+    int i;
+
+    gain = 1.0f;
+    if (AudioCompression) {
+	float max;
+
+	// find loudest sample
+	max = 0.0f;
+	for (c = 0; c < channels; ++c) {
+	    for (i = 0; i < frames; ++i) {
+		float t;
+
+		t = fabsf(planes[c][i]);
+		if (t > max) {
+		    max = t;
+		}
+	    }
+	}
+	if (AudioCompressorUpdate(max >= 1.0f ? -INT16_MIN : (int)(max *
+		    32768.0f))) {
+	    gain = AudioCompressionFactor / 1000.0f;
+	}
+    }
+    if (AudioNormalize) {
+	float scale;
+	int f;
+	int n;
+
+	// compressed sum of squares in the units of AudioNormalizer
+	scale = gain * gain * (32768.0f * 32768.0f / AudioNormSamples);
+	for (f = 0; f < frames; f += n) {
+	    float sum;
+
+	    n = (AudioNormSamples - AudioNormCounter + channels -
+		1) / channels;
+	    if (n > frames - f) {
+		n = frames - f;
+	    }
+	    sum = 0.0f;
+	    for (c = 0; c < channels; ++c) {
+		for (i = f; i < f + n; ++i) {
+		    sum += planes[c][i] * planes[c][i];
+		}
+	    }
+	    AudioNormAverage[AudioNormIndex] += (uint32_t) (sum * scale);
+	    AudioNormCounter += n * channels;
+	    if (AudioNormCounter >= AudioNormSamples) {
+		AudioNormalizerBlock();
+	    }
+	}
+	gain *= AudioNormalizeFactor / 1000.0f;
+    }
+    return gain;
+}
+
+/**
+**	Convert planar float samples to interleaved hardware samples.
+**
+**	@param planes	sample planes
+**	@param channels	number of planes
+**	@param first	first frame to convert
+**	@param frames	number of frames to convert
+**	@param gain	gain of the samples
+**	@param out	interleaved output samples
+*/
+static void AudioSwrRender(float *const *planes, int channels, int first,
+    int frames, float gain, int16_t * out)
+{
+    int c;
+    int i;
+
+    gain *= 32768.0f;
+    for (c = 0; c < channels; ++c) {
+	const float *in;
+
+	in = planes[c] + first;
+	for (i = 0; i < frames; ++i) {
+	    float t;
+
+	    t = in[i] * gain;
+	    t = t < INT16_MIN ? INT16_MIN : t > INT16_MAX ? INT16_MAX : t;
+	    out[i * channels + c] = t < 0.0f ? t - 0.5f : t + 0.5f;
+	}
+    }
+}
+
+/**
+**	Write planar float samples into the write ring.
+**
+**	Converts directly into the ring buffer, in two parts at the wrap
+**	point.  The ring size is a multiple of all frame sizes, the write
+**	pointer is always frame aligned.
+**
+**	@param planes	sample planes
+**	@param channels	number of planes
+**	@param frames	number of samples in each plane
+**	@param gain	gain of the samples
+**
+**	@returns number of bytes written.
+*/
+static size_t AudioSwrWrite(float *const *planes, int channels, int frames,
+    float gain)
+{
+    RingBuffer *rb;
+    size_t frame_size;
+    int done;
+
+    rb = AudioRing[AudioRingWrite].RingBuffer;
+    frame_size = channels * AudioBytesProSample;
+    for (done = 0; done < frames;) {
+	void *p;
+	int n;
+
+	n = RingBufferGetWritePointer(rb, &p) / frame_size;
+	if (!n) {
+	    break;
+	}
+	if (n > frames - done) {
+	    n = frames - done;
+	}
+	AudioSwrRender(planes, channels, done, n, gain, p);
+	RingBufferWriteAdvance(rb, n * frame_size);
+	done += n;
+    }
+    return done * frame_size;
+}
+
+/**
+**	Convert samples with the float pipeline.
+**
+**	Remix, resample, compress and normalize in one pass.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+**	@param[out] planes	converted sample planes
+**	@param[out] gain	gain to apply to the planes
+**
+**	@returns number of frames in each plane, -1 if the float pipeline
+**	can't be used.
+*/
+static int AudioSwrConvert(const void *samples, int count, float **planes,
+    float *gain)
+{
+    const uint8_t *in;
+    int frames;
+    int out_frames;
+    int c;
+
+    if (!AudioSwrSetup()) {
+	return -1;
+    }
+    frames = count / (AudioSwrInChannels * AudioBytesProSample);
+    if ((out_frames = swr_get_out_samples(AudioSwr, frames)) < 0) {
+	Error(_("audio: float pipeline convert failed\n"));
+	return -1;
+    }
+    if (out_frames > AudioSwrFrames) {
+	float *buf;
+
+	// reserve some space, that the buffer isn't resized each packet
+	out_frames += out_frames / 4;
+	if (!(buf = realloc(AudioSwrBuffer,
+		    out_frames * 8 * sizeof(*AudioSwrBuffer)))) {
+	    Error(_("audio: out of memory\n"));
+	    return -1;
+	}
+	AudioSwrBuffer = buf;
+	AudioSwrFrames = out_frames;
+    }
+    for (c = 0; c < (int)AudioSwrHwChannels; ++c) {
+	planes[c] = AudioSwrBuffer + c * AudioSwrFrames;
+    }
+
+    in = samples;
+    out_frames =
+	swr_convert(AudioSwr, (uint8_t **) planes, AudioSwrFrames, &in,
+	frames);
+    if (out_frames < 0) {
+	Error(_("audio: float pipeline convert failed\n"));
+	return -1;
+    }
+    *gain = AudioSwrFilter(planes, AudioSwrHwChannels, out_frames);
+
+    return out_frames;
+}
+
+/**
+**	Cleanup float pipeline.
+*/
+static void AudioSwrExit(void)
+{
+    swr_free(&AudioSwr);
+    AudioSwrRing = -1;
+    free(AudioSwrBuffer);
+    AudioSwrBuffer = NULL;
+    AudioSwrFrames = 0;
+}
+
+/**
+**	Find hardware sample rate for unsupported input sample rates.
+**
+**	@param sample_rate	input sample-rate frequency
+**	@param channels		number of channels
+**
+**	@returns rate table index or AudioRatesMax if none found.
+*/
+static unsigned AudioSwrRate(unsigned sample_rate, int channels)
+{
+    unsigned u;
+    unsigned best;
+
+    // prefer 48kHz, the nearest rate otherwise
+    best = AudioRatesMax;
+    for (u = 0; u < AudioRatesMax; ++u) {
+	if (!AudioChannelMatrix[u][channels]) {
+	    continue;
+	}
+	if (u == Audio48000) {
+	    return u;
+	}
+	if (best == AudioRatesMax
+	    || abs((int)AudioRatesTable[u] - (int)sample_rate) <
+	    abs((int)AudioRatesTable[best] - (int)sample_rate)) {
+	    best = u;
+	}
+    }
+    return best;
+}
+
+#endif
+
 /**
 **	Add sample-rate, number of channels change to ring.
 **
@@ -683,10 +1262,27 @@ static int AudioRingAdd(unsigned sample_rate, int channels, int passthrough)
 	    break;
 	}
     }
+#ifdef USE_SWRESAMPLE
+    // float pipeline resamples to a supported rate
+    if (!passthrough
+	&& (u = AudioSwrRate(sample_rate, channels)) < AudioRatesMax) {
+	goto found;
+    }
+#endif
     Error(_("audio: %dHz sample-rate unsupported\n"), sample_rate);
     return -1;				// unsupported sample-rate
 
   found:
+#ifdef USE_SWRESAMPLE
+    // float pipeline resamples to a rate supporting the channels
+    if (!passthrough && !AudioChannelMatrix[u][channels]) {
+	unsigned r;
+
+	if ((r = AudioSwrRate(sample_rate, channels)) < AudioRatesMax) {
+	    u = r;
+	}
+    }
+#endif
     if (!AudioChannelMatrix[u][channels]) {
 	Error(_("audio: %d channels unsupported\n"), channels);
 	return -1;			// unsupported nr. of channels
@@ -704,7 +1300,7 @@ static int AudioRingAdd(unsigned sample_rate, int channels, int passthrough)
     AudioRing[AudioRingWrite].PacketSize = 0;
     AudioRing[AudioRingWrite].InSampleRate = sample_rate;
     AudioRing[AudioRingWrite].InChannels = channels;
-    AudioRing[AudioRingWrite].HwSampleRate = sample_rate;
+    AudioRing[AudioRingWrite].HwSampleRate = AudioRatesTable[u];
     AudioRing[AudioRingWrite].HwChannels = AudioChannelMatrix[u][channels];
     AudioRing[AudioRingWrite].PTS = INT64_C(0x8000000000000000);
     RingBufferReset(AudioRing[AudioRingWrite].RingBuffer);
@@ -719,6 +1315,7 @@ static int AudioRingAdd(unsigned sample_rate, int channels, int passthrough)
 	// tell thread, that there is something todo
 	AudioRunning = 1;
 	pthread_cond_signal(&AudioStartCond);
+	AudioEventSignal(1);
     }
 #endif
 
@@ -756,6 +1353,9 @@ static void AudioRingExit(void)
     }
     AudioRingRead = 0;
     AudioRingWrite = 0;
+#ifdef USE_SWRESAMPLE
+    AudioSwrExit();
+#endif
 }
 
 #ifdef USE_ALSA
@@ -957,6 +1557,57 @@ static void AlsaFlushBuffers(void)
 //	thread playback
 //----------------------------------------------------------------------------
 
+/**
+**	Wait for space in kernel buffers or a play thread command.
+**
+**	Like snd_pcm_wait(), but the play thread event is polled too.
+**
+**	@param timeout	timeout in ms
+**
+**	@retval	<0	alsa error code
+**	@retval 0	woken by a command
+**	@retval	1	device ready or timeout
+*/
+static int AlsaWait(int timeout)
+{
+    struct pollfd *fds;
+    unsigned short revents;
+    int n;
+    int err;
+
+    n = snd_pcm_poll_descriptors_count(AlsaPCMHandle);
+    if (n <= 0) {
+	return snd_pcm_wait(AlsaPCMHandle, timeout);
+    }
+    fds = alloca((n + 1) * sizeof(*fds));
+    n = snd_pcm_poll_descriptors(AlsaPCMHandle, fds, n);
+
+    if ((err = AudioPollEvents(fds, n, timeout)) < 0) {
+	return -errno;
+    }
+    if (!err) {
+	// timeout: let the caller try to play, command: handle it first
+	return fds[n].revents & POLLIN ? 0 : 1;
+    }
+    if ((err = snd_pcm_poll_descriptors_revents(AlsaPCMHandle, fds, n,
+		&revents)) < 0) {
+	return err;
+    }
+    if (revents & (POLLERR | POLLNVAL)) {
+	switch (snd_pcm_state(AlsaPCMHandle)) {
+	    case SND_PCM_STATE_XRUN:
+		return -EPIPE;
+	    case SND_PCM_STATE_SUSPENDED:
+		return -ESTRPIPE;
+	    case SND_PCM_STATE_DISCONNECTED:
+		return -ENODEV;
+	    default:
+		return -EIO;
+	}
+    }
+    return 1;
+}
+
 /**
 **	Alsa thread
 **
@@ -979,7 +1630,7 @@ static int AlsaThread(void)
 	    return 1;
 	}
 	// wait for space in kernel buffers
-	if ((err = snd_pcm_wait(AlsaPCMHandle, 24)) < 0) {
+	if ((err = AlsaWait(24)) < 0) {
 	    Warning(_("audio/alsa: wait underrun error? '%s'\n"),
 		snd_strerror(err));
 	    err = snd_pcm_recover(AlsaPCMHandle, err, 0);
@@ -992,7 +1643,7 @@ static int AlsaThread(void)
 	}
 	break;
     }
-    if (AudioPaused) {		// timeout or some commands
+    if (!err || AudioPaused) {		// some commands
 	return 1;
     }
 
@@ -1010,7 +1661,7 @@ static int AlsaThread(void)
 	    return 0;
 	}
 
-	usleep(24 * 1000);		// let fill/empty the buffers
+	AudioWaitEvent(24);		// let fill/empty the buffers
     }
     return 1;
 }
@@ -1582,18 +2233,17 @@ static int OssThread(void)
 	return -1;
     }
     for (;;) {
-	struct pollfd fds[1];
+	struct pollfd fds[2];
 
 	if (AudioPaused) {
 	    return 1;
 	}
-	// wait for space in kernel buffers
+	// wait for space in kernel buffers or a command
 	fds[0].fd = OssPcmFildes;
 	fds[0].events = POLLOUT | POLLERR;
-	// wait for space in kernel buffers
-	err = poll(fds, 1, OssFragmentTime);
+	err = AudioPollEvents(fds, 1, OssFragmentTime);
 	if (err < 0) {
-	    if (err == EAGAIN) {
+	    if (errno == EAGAIN) {
 		continue;
 	    }
 	    Error(_("audio/oss: error poll %s\n"), strerror(errno));
@@ -1610,8 +2260,7 @@ static int OssThread(void)
 	if (err < 0) {			// underrun error
 	    return -1;
 	}
-	sched_yield();
-	usleep(OssFragmentTime * 1000);	// let fill/empty the buffers
+	AudioWaitEvent(OssFragmentTime);	// let fill/empty the buffers
 	return 0;
     }
 
@@ -2102,6 +2751,7 @@ static void *AudioPlayHandlerThread(void *dummy)
 	AudioRunning = 0;
 	do {
 	    pthread_cond_wait(&AudioStartCond, &AudioMutex);
+	    atomic_inc(&AudioWakeups);
 	    // cond_wait can return, without signal!
 	} while (!AudioRunning);
 	pthread_mutex_unlock(&AudioMutex);
@@ -2124,7 +2774,6 @@ static void *AudioPlayHandlerThread(void *dummy)
 		Debug(3, "audio: play thread stopped\n");
 		return PTHREAD_CANCELED;
 	    }
-	    usleep(1000); //prevent high cpu load
 	    // look if there is a flush command in the queue
 	    flush = 0;
 	    filled = atomic_read(&AudioRingFilled);
@@ -2172,6 +2821,12 @@ static void *AudioPlayHandlerThread(void *dummy)
 			    Debug(3, "audio: alsa underrun, playing silence\n");
 			    last_xrun_message = GetMsTicks();
 			}
+			// paused: AudioWaitEvent() doesn't sleep, wait for start
+			if (AudioPaused) {
+			    break;
+			}
+			// sleep until samples or commands arrive
+			AudioWaitEvent(100);
 			continue;
 		    } else {
 			Debug(3, "audio: buffer empty or pcm not running, and no new ring buffer, goto sleep\n");
@@ -2228,8 +2883,11 @@ static void *AudioPlayHandlerThread(void *dummy)
 static void AudioInitThread(void)
 {
     AudioThreadStop = 0;
+    if ((AudioEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+	Error(_("audio: can't create play thread event: %s\n"),
+	    strerror(errno));
+    }
     pthread_mutex_init(&AudioMutex, NULL);
-    pthread_mutex_init(&PTS_mutex, NULL);
     pthread_mutex_init(&ReadAdvance_mutex, NULL);
     pthread_cond_init(&AudioStartCond, NULL);
     pthread_create(&AudioThread, NULL, AudioPlayHandlerThread, NULL);
@@ -2249,15 +2907,19 @@ static void AudioExitThread(void)
 	AudioThreadStop = 1;
 	AudioRunning = 1;		// wakeup thread, if needed
 	pthread_cond_signal(&AudioStartCond);
+	AudioEventSignal(1);
 	if (pthread_join(AudioThread, &retval) || retval != PTHREAD_CANCELED) {
 	    Error(_("audio: can't cancel play thread\n"));
 	}
 	pthread_cond_destroy(&AudioStartCond);
 	pthread_mutex_destroy(&AudioMutex);
-	pthread_mutex_destroy(&PTS_mutex);
 	pthread_mutex_destroy(&ReadAdvance_mutex);
 	AudioThread = 0;
     }
+    if (AudioEventFd != -1) {
+	close(AudioEventFd);
+	AudioEventFd = -1;
+    }
 }
 
 #endif
@@ -2289,6 +2951,74 @@ void AudioDelayms(int delayms) //jojo
         1000;
 }
 
+/**
+**	Convert samples directly into the write ring buffer.
+**
+**	Resample, compress and normalize in place in the ring buffer, in two
+**	parts at the wrap point.  Each part is finished, before it is given
+**	to the play thread.
+**
+**	@param samples	sample buffer
+**	@param count	number of bytes in sample buffer
+**	@param[out] part	written ring buffer parts
+**	@param[out] part_size	number of bytes in each part
+**
+**	@returns number of bytes written.
+*/
+static size_t AudioRingConvert(const int16_t * samples, int count,
+    int16_t ** part, size_t * part_size)
+{
+    RingBuffer *rb;
+    int in_chan;
+    int out_chan;
+    int frames;
+    size_t written;
+    int i;
+
+    rb = AudioRing[AudioRingWrite].RingBuffer;
+    in_chan = AudioRing[AudioRingWrite].InChannels;
+    out_chan = AudioRing[AudioRingWrite].HwChannels;
+    frames = count / (in_chan * AudioBytesProSample);
+    written = 0;
+    for (i = 0; i < 2; ++i) {
+	void *p;
+	int n;
+
+	part[i] = NULL;
+	part_size[i] = 0;
+	// ring size is a multiple of all frame sizes, no frame is split
+	n = RingBufferGetWritePointer(rb, &p) / (out_chan *
+	    AudioBytesProSample);
+	if (n > frames) {
+	    n = frames;
+	}
+	if (!n) {
+	    continue;
+	}
+#ifdef USE_AUDIO_MIXER
+	// Convert / resample input to hardware format
+	AudioResample(samples, in_chan, n, p, out_chan);
+#else
+	memcpy(p, samples, n * in_chan * AudioBytesProSample);
+#endif
+	part[i] = p;
+	part_size[i] = n * out_chan * AudioBytesProSample;
+
+	if (AudioCompression) {		// in place operation
+	    AudioCompressor(part[i], part_size[i]);
+	}
+	if (AudioNormalize) {		// in place operation
+	    AudioNormalizer(part[i], part_size[i]);
+	}
+	RingBufferWriteAdvance(rb, part_size[i]);
+
+	samples += n * in_chan;
+	frames -= n;
+	written += part_size[i];
+    }
+    return written;
+}
+
 /**
 **	Place samples in audio output queue.
 **
@@ -2298,9 +3028,18 @@ void AudioDelayms(int delayms) //jojo
 void AudioEnqueue(const void *samples, int count)
 {
     size_t n = 0;
-    int16_t *buffer;
+    int in_count;
+    int16_t *part[2];
+    size_t part_size[2];
     int times_delay;
     int times_count;
+    int modify;
+
+#ifdef USE_SWRESAMPLE
+    float *swr_planes[8];
+    float swr_gain;
+    int swr_frames;
+#endif
 
 
 #ifdef noDEBUG
@@ -2324,45 +3063,42 @@ void AudioEnqueue(const void *samples, int count)
 	Debug(3, "audio: a/v packet size %d bytes\n", count);
     }
     // audio sample modification allowed and needed?
-    buffer = (void *)samples;
-    if (!AudioRing[AudioRingWrite].Passthrough && (AudioCompression
-	    || AudioNormalize
-	    || AudioRing[AudioRingWrite].InChannels !=
-	    AudioRing[AudioRingWrite].HwChannels)) {
-	int frames;
-
-	// resample into ring-buffer is too complex in the case of a roundabout
-	// just use a temporary buffer
-	frames =
-	    count / (AudioRing[AudioRingWrite].InChannels *
-	    AudioBytesProSample);
-	buffer =
-	    alloca(frames * AudioRing[AudioRingWrite].HwChannels *
-	    AudioBytesProSample);
-#ifdef USE_AUDIO_MIXER
-	// Convert / resample input to hardware format
-	AudioResample(samples, AudioRing[AudioRingWrite].InChannels, frames,
-	    buffer, AudioRing[AudioRingWrite].HwChannels);
-#else
-#ifdef DEBUG
+    in_count = count;
+    modify = !AudioRing[AudioRingWrite].Passthrough && (AudioCompression
+	|| AudioNormalize
+	|| AudioRing[AudioRingWrite].InChannels !=
+	AudioRing[AudioRingWrite].HwChannels);
+#ifdef USE_SWRESAMPLE
+    // float pipeline: remix, resample, compress and normalize in one pass
+    swr_frames = -1;
+    if (!AudioRing[AudioRingWrite].Passthrough && (modify
+	    || AudioRing[AudioRingWrite].InSampleRate !=
+	    AudioRing[AudioRingWrite].HwSampleRate)) {
+	swr_frames = AudioSwrConvert(samples, count, swr_planes, &swr_gain);
+	if (swr_frames >= 0) {
+	    modify = 0;
+	    count =
+		swr_frames * AudioRing[AudioRingWrite].HwChannels *
+		AudioBytesProSample;
+	} else if (AudioRing[AudioRingWrite].InSampleRate !=
+	    AudioRing[AudioRingWrite].HwSampleRate) {
+	    return;			// can't play without resample
+	}
+    }
+#endif
+    if (modify) {
+#if !defined(USE_AUDIO_MIXER) && defined(DEBUG)
 	if (AudioRing[AudioRingWrite].InChannels !=
 	    AudioRing[AudioRingWrite].HwChannels) {
 	    Debug(3, "audio: internal failure channels mismatch\n");
 	    return;
 	}
 #endif
-	memcpy(buffer, samples, count);
-#endif
+	// converted directly into the ring buffer
 	count =
-	    frames * AudioRing[AudioRingWrite].HwChannels *
+	    count / (AudioRing[AudioRingWrite].InChannels *
+	    AudioBytesProSample) * AudioRing[AudioRingWrite].HwChannels *
 	    AudioBytesProSample;
-
-	if (AudioCompression) {		// in place operation
-	    AudioCompressor(buffer, count);
-	}
-	if (AudioNormalize) {		// in place operation
-	    AudioNormalizer(buffer, count);
-	}
     }
 
     //write RingBuffer some times for delay audio
@@ -2373,8 +3109,27 @@ void AudioEnqueue(const void *samples, int count)
         Debug(3, "audio: dupped frame %d times\n", times_delay);
     }
     while(times_count <= times_delay){
-	pthread_mutex_lock(&PTS_mutex);
-	n = RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, buffer, count);
+	AudioPtsWriteBegin();
+#ifdef USE_SWRESAMPLE
+	if (swr_frames >= 0) {		// convert directly into ring buffer
+	    n = AudioSwrWrite(swr_planes,
+		AudioRing[AudioRingWrite].HwChannels, swr_frames, swr_gain);
+	} else
+#endif
+	if (modify && !times_count) {	// convert directly into ring buffer
+	    n = AudioRingConvert(samples, in_count, part, part_size);
+	} else if (modify) {
+	    // repeat converted samples, they are still in the ring buffer
+	    // and aren't overwritten, because the block is much smaller
+	    // than the ring buffer.
+	    n = RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, part[0],
+		part_size[0]);
+	    n += RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer,
+		part[1], part_size[1]);
+	} else {
+	    n = RingBufferWrite(AudioRing[AudioRingWrite].RingBuffer, samples,
+		count);
+	}
 	if (n != (size_t) count) {
 	    Error(_("audio: can't place %d samples in ring buffer\n"), count);
 	    // too many bytes are lost
@@ -2388,10 +3143,13 @@ void AudioEnqueue(const void *samples, int count)
 		/ (AudioRing[AudioRingWrite].HwSampleRate *
 		AudioRing[AudioRingWrite].HwChannels * AudioBytesProSample);
 	}
-	pthread_mutex_unlock(&PTS_mutex);
+	AudioPtsWriteEnd();
         times_count++;
     }
     Dupped = 0;
+#ifdef USE_AUDIO_THREAD
+    AudioEventSignal(0);		// wakeup idle play thread
+#endif
 
     if (!AudioRunning) {		// check, if we can start the thread
 	int skip;
@@ -2533,7 +3291,10 @@ void AudioVideoReady(int64_t pts)
 		AudioSkip = skip - used;
 		skip = used;
 	    }
+	    // replay: the play thread can read the same ring
+	    pthread_mutex_lock(&ReadAdvance_mutex);
 	    RingBufferReadAdvance(AudioRing[AudioRingWrite].RingBuffer, skip);
+	    pthread_mutex_unlock(&ReadAdvance_mutex);
 
 	    used = RingBufferUsedBytes(AudioRing[AudioRingWrite].RingBuffer);
 	} else {
@@ -2644,6 +3405,9 @@ void AudioFlushBuffers(void)
     EnoughAudio = 0;
 
     atomic_inc(&AudioRingFilled);
+#ifdef USE_AUDIO_THREAD
+    AudioEventSignal(1);
+#endif
 
     // FIXME: wait for flush complete needed?
     for (i = 0; i < 24 * 2; ++i) {
@@ -2728,7 +3492,9 @@ void AudioSetClock(int64_t pts)
 	    Timestamp2String(AudioRing[AudioRingWrite].PTS),
 	    Timestamp2String(pts));
     }
+    AudioPtsWriteBegin();
     AudioRing[AudioRingWrite].PTS = pts;
+    AudioPtsWriteEnd();
 }
 
 /**
@@ -2738,22 +3504,60 @@ void AudioSetClock(int64_t pts)
 */
 int64_t AudioGetClock(void)
 {
-    int64_t pts = INT64_C(0x8000000000000000);
-    pthread_mutex_lock(&PTS_mutex);
+    int64_t pts;
+    int seq;
+
     pthread_mutex_lock(&ReadAdvance_mutex);
-    // (cast) needed for the evil gcc
-    if (AudioRing[AudioRingRead].PTS != (int64_t) INT64_C(0x8000000000000000)) {
-	int64_t delay;
-	// delay zero, if no valid time stamp
-	if ((delay = AudioGetDelay())) {
-	    pts = AudioRing[AudioRingRead].PTS + 0 * 90 - delay;
+    // lock free against AudioEnqueue, retry if PTS changed meanwhile
+    do {
+	int64_t ring_pts;
+
+	while ((seq = atomic_load_acquire(&AudioPtsSeq)) & 1) {
+	    sched_yield();		// writer active
 	}
-    }
+	pts = INT64_C(0x8000000000000000);
+	ring_pts = AudioRing[AudioRingRead].PTS;
+	// (cast) needed for the evil gcc
+	if (ring_pts != (int64_t) INT64_C(0x8000000000000000)) {
+	    int64_t delay;
+
+	    // delay zero, if no valid time stamp
+	    if ((delay = AudioGetDelay())) {
+		pts = ring_pts + 0 * 90 - delay;
+	    }
+	}
+	atomic_acquire_fence();
+    } while (seq != atomic_read(&AudioPtsSeq));
     pthread_mutex_unlock(&ReadAdvance_mutex);
-    pthread_mutex_unlock(&PTS_mutex);
+
     return pts;
 }
 
+/**
+**	Get audio statistics.
+**
+**	@param[out] wakeups	play thread wakeups per second, averaged since
+**				the last call
+*/
+void AudioGetStats(int *wakeups)
+{
+#ifdef USE_AUDIO_THREAD
+    static uint32_t last_tick;
+    static int last_wakeups;
+    uint32_t tick;
+    int cnt;
+
+    tick = GetMsTicks();
+    cnt = atomic_read(&AudioWakeups);
+    *wakeups = tick != last_tick ?
+	((int64_t) (cnt - last_wakeups) * 1000) / (tick - last_tick) : 0;
+    last_tick = tick;
+    last_wakeups = cnt;
+#else
+    *wakeups = 0;
+#endif
+}
+
 /**
 **	Set mixer volume (0-1000)
 **
@@ -2831,6 +3635,9 @@ void AudioPause(void)
     }
     Debug(3, "audio: paused\n");
     AudioPaused = 1;
+#ifdef USE_AUDIO_THREAD
+    AudioEventSignal(1);
+#endif
 }
 
 /**
@@ -3016,6 +3823,8 @@ void AudioInit(void)
 
   found:
     AudioDoingInit = 1;
+    name = AudioDspInit();
+    Debug(3, "audio: using %s dsp kernels\n", name);
     AudioRingInit();
     AudioUsedModule->Init();
     //
@@ -35,6 +35,7 @@ extern int AudioUsedBytes(void);	///< used bytes in audio output
 extern int64_t AudioGetDelay(void);	///< get current audio delay
 extern void AudioSetClock(int64_t);	///< set audio clock base
 extern int64_t AudioGetClock();		///< get current audio clock
+extern void AudioGetStats(int *);	///< get audio statistics
 extern void AudioSetVolume(int);	///< set volume
 extern int AudioSetup(int *, int *, int);	///< setup audio output
 
@@ -0,0 +1,777 @@
+///
+///	@file audiodsp.c	@brief Audio DSP kernel module
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup AudioDsp The audio DSP kernel module.
+///
+///	The audio filters (normalizer, compressor, soft amplifier) run on
+///	every AudioEnqueue, these kernels do their inner loops over the
+///	16 bit samples.  All kernels give bit identical results to the C
+///	reference kernels.
+///
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "audiodsp.h"
+
+/**
+**	Audio DSP kernel structure and typedef.
+*/
+typedef struct _audio_dsp_
+{
+    const char *Name;			///< kernel name
+
+    int (*const Supported) (void);	///< cpu supports kernel
+    /// sum of t * t >> AUDIO_DSP_SHIFT
+     uint32_t(*const SumSquares) (const int16_t *, int);
+    int (*const MaxAbs) (const int16_t *, int);	///< loudest sample
+    void (*const Scale) (int16_t *, int, int);	///< scale samples by /1000
+} AudioDspKernel;
+
+//----------------------------------------------------------------------------
+//	C reference kernels
+//----------------------------------------------------------------------------
+
+/**
+**	C kernel always supported.
+*/
+static int AudioDspSupportedC(void)
+{
+    return 1;
+}
+
+/**
+**	Sum squares of samples, each shifted right by AUDIO_DSP_SHIFT.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static uint32_t AudioDspSumSquaresC(const int16_t * data, int n)
+{
+    uint32_t sum;
+    int i;
+
+    sum = 0U;
+    for (i = 0; i < n; ++i) {
+	int t;
+
+	t = data[i];
+	sum += (t * t) / (1 << AUDIO_DSP_SHIFT);
+    }
+    return sum;
+}
+
+/**
+**	Find loudest sample.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static int AudioDspMaxAbsC(const int16_t * data, int n)
+{
+    int max_sample;
+    int i;
+
+    max_sample = 0;
+    for (i = 0; i < n; ++i) {
+	int t;
+
+	t = abs(data[i]);
+	if (t > max_sample) {
+	    max_sample = t;
+	}
+    }
+    return max_sample;
+}
+
+/**
+**	Scale samples by factor / 1000 with hard clipping.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor * 1000
+*/
+static void AudioDspScaleC(int16_t * data, int n, int factor)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+	int t;
+
+	t = (data[i] * factor) / 1000;
+	if (t < INT16_MIN) {
+	    t = INT16_MIN;
+	} else if (t > INT16_MAX) {
+	    t = INT16_MAX;
+	}
+	data[i] = t;
+    }
+}
+
+    /// C reference kernels
+static const AudioDspKernel AudioDspC = {
+    .Name = "C",
+    .Supported = AudioDspSupportedC,
+    .SumSquares = AudioDspSumSquaresC,
+    .MaxAbs = AudioDspMaxAbsC,
+    .Scale = AudioDspScaleC,
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//----------------------------------------------------------------------------
+//	SSE2 kernels
+//----------------------------------------------------------------------------
+
+/**
+**	Check cpu supports SSE2.
+*/
+static int AudioDspSupportedSse2(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+/**
+**	Sum squares of samples, SSE2 version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+__attribute__ ((target("sse2")))
+static uint32_t AudioDspSumSquaresSse2(const int16_t * data, int n)
+{
+    __m128i acc;
+    uint32_t lanes[4];
+    int i;
+
+    acc = _mm_setzero_si128();
+    for (i = 0; i + 8 <= n; i += 8) {
+	__m128i v;
+	__m128i lo;
+	__m128i hi;
+
+	v = _mm_loadu_si128((const __m128i *)(data + i));
+	lo = _mm_mullo_epi16(v, v);
+	hi = _mm_mulhi_epi16(v, v);
+	// t * t is positive and < 2^31, logical shift is the division
+	acc = _mm_add_epi32(acc,
+	    _mm_srli_epi32(_mm_unpacklo_epi16(lo, hi), AUDIO_DSP_SHIFT));
+	acc = _mm_add_epi32(acc,
+	    _mm_srli_epi32(_mm_unpackhi_epi16(lo, hi), AUDIO_DSP_SHIFT));
+    }
+    _mm_storeu_si128((__m128i *) lanes, acc);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+	+ AudioDspSumSquaresC(data + i, n - i);
+}
+
+/**
+**	Find loudest sample, SSE2 version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+__attribute__ ((target("sse2")))
+static int AudioDspMaxAbsSse2(const int16_t * data, int n)
+{
+    __m128i vmax;
+    __m128i vmin;
+    int16_t lanes_max[8];
+    int16_t lanes_min[8];
+    int max_sample;
+    int i;
+
+    // abs(INT16_MIN) didn't fit, track min and max
+    vmax = _mm_setzero_si128();
+    vmin = _mm_setzero_si128();
+    for (i = 0; i + 8 <= n; i += 8) {
+	__m128i v;
+
+	v = _mm_loadu_si128((const __m128i *)(data + i));
+	vmax = _mm_max_epi16(vmax, v);
+	vmin = _mm_min_epi16(vmin, v);
+    }
+    _mm_storeu_si128((__m128i *) lanes_max, vmax);
+    _mm_storeu_si128((__m128i *) lanes_min, vmin);
+
+    max_sample = AudioDspMaxAbsC(data + i, n - i);
+    for (i = 0; i < 8; ++i) {
+	if (lanes_max[i] > max_sample) {
+	    max_sample = lanes_max[i];
+	}
+	if (-lanes_min[i] > max_sample) {
+	    max_sample = -lanes_min[i];
+	}
+    }
+    return max_sample;
+}
+
+/**
+**	Divide the two low 32 bit integers by 1000, truncate towards zero.
+**
+**	@param p	products, only the two low lanes are used
+*/
+__attribute__ ((target("sse2")))
+static inline __m128i AudioDspDiv1000Sse2(__m128i p)
+{
+    __m128d d;
+
+    d = _mm_cvtepi32_pd(p);
+    d = _mm_add_pd(d, _mm_or_pd(_mm_set1_pd(0.5), _mm_and_pd(d,
+		_mm_set1_pd(-0.0))));
+    return _mm_cvttpd_epi32(_mm_mul_pd(d, _mm_set1_pd(0.001)));
+}
+
+/**
+**	Scale samples by factor / 1000, SSE2 version.
+**
+**	The products are build with 16 bit multiplies, the division is done
+**	in double precision.  The product is moved by 0.5 away from zero,
+**	this keeps the truncated result exact for all 32 bit products.
+**	Saturating pack does the clipping.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor * 1000
+*/
+__attribute__ ((target("sse2")))
+static void AudioDspScaleSse2(int16_t * data, int n, int factor)
+{
+    __m128i f;
+    int i;
+
+    if (factor > INT16_MAX) {		// 16 bit multiplies only
+	AudioDspScaleC(data, n, factor);
+	return;
+    }
+    f = _mm_set1_epi16(factor);
+    for (i = 0; i + 8 <= n; i += 8) {
+	__m128i v;
+	__m128i lo;
+	__m128i hi;
+	__m128i p0;
+	__m128i p1;
+	__m128i q0;
+	__m128i q1;
+
+	v = _mm_loadu_si128((const __m128i *)(data + i));
+	lo = _mm_mullo_epi16(v, f);
+	hi = _mm_mulhi_epi16(v, f);
+	p0 = _mm_unpacklo_epi16(lo, hi);
+	p1 = _mm_unpackhi_epi16(lo, hi);
+
+	q0 = _mm_unpacklo_epi64(AudioDspDiv1000Sse2(p0),
+	    AudioDspDiv1000Sse2(_mm_unpackhi_epi64(p0, p0)));
+	q1 = _mm_unpacklo_epi64(AudioDspDiv1000Sse2(p1),
+	    AudioDspDiv1000Sse2(_mm_unpackhi_epi64(p1, p1)));
+
+	_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(q0, q1));
+    }
+    AudioDspScaleC(data + i, n - i, factor);
+}
+
+    /// SSE2 kernels
+static const AudioDspKernel AudioDspSse2 = {
+    .Name = "SSE2",
+    .Supported = AudioDspSupportedSse2,
+    .SumSquares = AudioDspSumSquaresSse2,
+    .MaxAbs = AudioDspMaxAbsSse2,
+    .Scale = AudioDspScaleSse2,
+};
+
+//----------------------------------------------------------------------------
+//	AVX2 kernels
+//----------------------------------------------------------------------------
+
+/**
+**	Check cpu supports AVX2.
+*/
+static int AudioDspSupportedAvx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+/**
+**	Sum squares of samples, AVX2 version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+__attribute__ ((target("avx2")))
+static uint32_t AudioDspSumSquaresAvx2(const int16_t * data, int n)
+{
+    __m256i acc;
+    uint32_t lanes[8];
+    uint32_t sum;
+    int i;
+
+    acc = _mm256_setzero_si256();
+    for (i = 0; i + 16 <= n; i += 16) {
+	__m256i v;
+	__m256i lo;
+	__m256i hi;
+
+	v = _mm256_loadu_si256((const __m256i *)(data + i));
+	lo = _mm256_mullo_epi16(v, v);
+	hi = _mm256_mulhi_epi16(v, v);
+	acc = _mm256_add_epi32(acc,
+	    _mm256_srli_epi32(_mm256_unpacklo_epi16(lo, hi), AUDIO_DSP_SHIFT));
+	acc = _mm256_add_epi32(acc,
+	    _mm256_srli_epi32(_mm256_unpackhi_epi16(lo, hi), AUDIO_DSP_SHIFT));
+    }
+    _mm256_storeu_si256((__m256i *) lanes, acc);
+
+    sum = AudioDspSumSquaresC(data + i, n - i);
+    for (i = 0; i < 8; ++i) {
+	sum += lanes[i];
+    }
+    return sum;
+}
+
+/**
+**	Find loudest sample, AVX2 version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+__attribute__ ((target("avx2")))
+static int AudioDspMaxAbsAvx2(const int16_t * data, int n)
+{
+    __m256i vmax;
+    __m256i vmin;
+    int16_t lanes_max[16];
+    int16_t lanes_min[16];
+    int max_sample;
+    int i;
+
+    vmax = _mm256_setzero_si256();
+    vmin = _mm256_setzero_si256();
+    for (i = 0; i + 16 <= n; i += 16) {
+	__m256i v;
+
+	v = _mm256_loadu_si256((const __m256i *)(data + i));
+	vmax = _mm256_max_epi16(vmax, v);
+	vmin = _mm256_min_epi16(vmin, v);
+    }
+    _mm256_storeu_si256((__m256i *) lanes_max, vmax);
+    _mm256_storeu_si256((__m256i *) lanes_min, vmin);
+
+    max_sample = AudioDspMaxAbsC(data + i, n - i);
+    for (i = 0; i < 16; ++i) {
+	if (lanes_max[i] > max_sample) {
+	    max_sample = lanes_max[i];
+	}
+	if (-lanes_min[i] > max_sample) {
+	    max_sample = -lanes_min[i];
+	}
+    }
+    return max_sample;
+}
+
+/**
+**	Divide four 32 bit integers by 1000, truncate towards zero.
+**
+**	@param p	products
+*/
+__attribute__ ((target("avx2")))
+static inline __m128i AudioDspDiv1000Avx2(__m128i p)
+{
+    __m256d d;
+
+    d = _mm256_cvtepi32_pd(p);
+    d = _mm256_add_pd(d, _mm256_or_pd(_mm256_set1_pd(0.5),
+	    _mm256_and_pd(d, _mm256_set1_pd(-0.0))));
+    return _mm256_cvttpd_epi32(_mm256_mul_pd(d, _mm256_set1_pd(0.001)));
+}
+
+/**
+**	Scale samples by factor / 1000, AVX2 version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor * 1000
+*/
+__attribute__ ((target("avx2")))
+static void AudioDspScaleAvx2(int16_t * data, int n, int factor)
+{
+    __m256i f;
+    int i;
+
+    f = _mm256_set1_epi32(factor);
+    for (i = 0; i + 8 <= n; i += 8) {
+	__m256i p;
+	__m128i q0;
+	__m128i q1;
+
+	p = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const
+			__m128i *)(data + i))), f);
+	q0 = AudioDspDiv1000Avx2(_mm256_castsi256_si128(p));
+	q1 = AudioDspDiv1000Avx2(_mm256_extracti128_si256(p, 1));
+
+	_mm_storeu_si128((__m128i *) (data + i), _mm_packs_epi32(q0, q1));
+    }
+    AudioDspScaleC(data + i, n - i, factor);
+}
+
+    /// AVX2 kernels
+static const AudioDspKernel AudioDspAvx2 = {
+    .Name = "AVX2",
+    .Supported = AudioDspSupportedAvx2,
+    .SumSquares = AudioDspSumSquaresAvx2,
+    .MaxAbs = AudioDspMaxAbsAvx2,
+    .Scale = AudioDspScaleAvx2,
+};
+
+#endif
+
+#ifdef __ARM_NEON
+
+//----------------------------------------------------------------------------
+//	NEON kernels
+//----------------------------------------------------------------------------
+
+/**
+**	NEON is compile time selected.
+*/
+static int AudioDspSupportedNeon(void)
+{
+    return 1;
+}
+
+/**
+**	Sum squares of samples, NEON version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static uint32_t AudioDspSumSquaresNeon(const int16_t * data, int n)
+{
+    uint32x4_t acc;
+    uint32_t lanes[4];
+    int i;
+
+    acc = vdupq_n_u32(0);
+    for (i = 0; i + 8 <= n; i += 8) {
+	int16x8_t v;
+
+	v = vld1q_s16(data + i);
+	acc = vaddq_u32(acc,
+	    vshrq_n_u32(vreinterpretq_u32_s32(vmull_s16(vget_low_s16(v),
+			vget_low_s16(v))), AUDIO_DSP_SHIFT));
+	acc = vaddq_u32(acc,
+	    vshrq_n_u32(vreinterpretq_u32_s32(vmull_s16(vget_high_s16(v),
+			vget_high_s16(v))), AUDIO_DSP_SHIFT));
+    }
+    vst1q_u32(lanes, acc);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+	+ AudioDspSumSquaresC(data + i, n - i);
+}
+
+/**
+**	Find loudest sample, NEON version.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+static int AudioDspMaxAbsNeon(const int16_t * data, int n)
+{
+    int16x8_t vmax;
+    int16x8_t vmin;
+    int16_t lanes_max[8];
+    int16_t lanes_min[8];
+    int max_sample;
+    int i;
+
+    vmax = vdupq_n_s16(0);
+    vmin = vdupq_n_s16(0);
+    for (i = 0; i + 8 <= n; i += 8) {
+	int16x8_t v;
+
+	v = vld1q_s16(data + i);
+	vmax = vmaxq_s16(vmax, v);
+	vmin = vminq_s16(vmin, v);
+    }
+    vst1q_s16(lanes_max, vmax);
+    vst1q_s16(lanes_min, vmin);
+
+    max_sample = AudioDspMaxAbsC(data + i, n - i);
+    for (i = 0; i < 8; ++i) {
+	if (lanes_max[i] > max_sample) {
+	    max_sample = lanes_max[i];
+	}
+	if (-lanes_min[i] > max_sample) {
+	    max_sample = -lanes_min[i];
+	}
+    }
+    return max_sample;
+}
+
+/**
+**	Scale samples by factor / 1000, NEON version.
+**
+**	Division by 1000 is done with the magic multiplier 0x10624DD3 >> 38
+**	and +1 correction for negative products (truncate towards zero).
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor * 1000
+*/
+static void AudioDspScaleNeon(int16_t * data, int n, int factor)
+{
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	int16x8_t v;
+	int32x4_t p0;
+	int32x4_t p1;
+	int32x4_t q0;
+	int32x4_t q1;
+
+	v = vld1q_s16(data + i);
+	p0 = vmulq_n_s32(vmovl_s16(vget_low_s16(v)), factor);
+	p1 = vmulq_n_s32(vmovl_s16(vget_high_s16(v)), factor);
+	// (2 * p * M) >> 32 >> 7 == (p * M) >> 38
+	q0 = vshrq_n_s32(vqdmulhq_n_s32(p0, 0x10624DD3), 7);
+	q1 = vshrq_n_s32(vqdmulhq_n_s32(p1, 0x10624DD3), 7);
+	q0 = vsubq_s32(q0, vshrq_n_s32(p0, 31));
+	q1 = vsubq_s32(q1, vshrq_n_s32(p1, 31));
+
+	vst1q_s16(data + i, vcombine_s16(vqmovn_s32(q0), vqmovn_s32(q1)));
+    }
+    AudioDspScaleC(data + i, n - i, factor);
+}
+
+    /// NEON kernels
+static const AudioDspKernel AudioDspNeon = {
+    .Name = "NEON",
+    .Supported = AudioDspSupportedNeon,
+    .SumSquares = AudioDspSumSquaresNeon,
+    .MaxAbs = AudioDspMaxAbsNeon,
+    .Scale = AudioDspScaleNeon,
+};
+
+#endif
+
+    /// table of all DSP kernels, best first
+static const AudioDspKernel *AudioDspKernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    &AudioDspAvx2,
+    &AudioDspSse2,
+#endif
+#ifdef __ARM_NEON
+    &AudioDspNeon,
+#endif
+    &AudioDspC,
+};
+
+    /// selected DSP kernels
+static const AudioDspKernel *AudioDspUsed = &AudioDspC;
+
+/**
+**	Select best DSP kernels supported by the cpu.
+**
+**	@returns name of the selected kernels.
+*/
+const char *AudioDspInit(void)
+{
+    unsigned u;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+    for (u = 0; u < sizeof(AudioDspKernels) / sizeof(*AudioDspKernels); ++u) {
+	if (AudioDspKernels[u]->Supported()) {
+	    AudioDspUsed = AudioDspKernels[u];
+	    break;
+	}
+    }
+    return AudioDspUsed->Name;
+}
+
+/**
+**	Sum squares of samples, each shifted right by AUDIO_DSP_SHIFT.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+uint32_t AudioDspSumSquares(const int16_t * data, int n)
+{
+    return AudioDspUsed->SumSquares(data, n);
+}
+
+/**
+**	Find loudest sample.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+*/
+int AudioDspMaxAbs(const int16_t * data, int n)
+{
+    return AudioDspUsed->MaxAbs(data, n);
+}
+
+/**
+**	Scale samples by factor / 1000 with hard clipping.
+**
+**	@param data	sample buffer
+**	@param n	number of samples in sample buffer
+**	@param factor	scale factor * 1000
+*/
+void AudioDspScale(int16_t * data, int n, int factor)
+{
+    AudioDspUsed->Scale(data, n, factor);
+}
+
+#ifdef AUDIODSP_TEST
+
+//----------------------------------------------------------------------------
+//	Test
+//----------------------------------------------------------------------------
+
+#include <time.h>
+
+/**
+**	Get time in us.
+*/
+static double AudioDspTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+/**
+**	Benchmark the DSP kernels.
+**
+**	Runs each cpu supported kernel over 8 channel 48 kHz samples,
+**	compares the results with the C reference kernels and prints the
+**	samples per second.
+**
+**	@returns number of kernels differing from the C reference.
+*/
+static int AudioDspBench(void)
+{
+    const int n = 8 * 48000;		// 1s 8ch 48kHz
+    const int loops = 200;
+    int16_t *samples;
+    int16_t *expected;
+    int16_t *buffer;
+    unsigned u;
+    int i;
+    int errors;
+
+    samples = malloc(n * sizeof(*samples));
+    expected = malloc(n * sizeof(*expected));
+    buffer = malloc(n * sizeof(*buffer));
+    for (i = 0; i < n; ++i) {
+	samples[i] = random() & 0xffff;
+    }
+    // C reference result of the pristine samples
+    memcpy(expected, samples, n * sizeof(*expected));
+    AudioDspC.Scale(expected, n, 1733);
+
+    errors = 0;
+    for (u = 0; u < sizeof(AudioDspKernels) / sizeof(*AudioDspKernels); ++u) {
+	const AudioDspKernel *dsp;
+	double tick;
+	uint32_t sum;
+	int max_sample;
+	int l;
+
+	dsp = AudioDspKernels[u];
+	if (!dsp->Supported()) {
+	    continue;
+	}
+	// compare with C reference
+	memcpy(buffer, samples, n * sizeof(*buffer));
+	dsp->Scale(buffer, n, 1733);
+	if (dsp->SumSquares(samples, n) != AudioDspC.SumSquares(samples, n)
+	    || dsp->MaxAbs(samples, n) != AudioDspC.MaxAbs(samples, n)
+	    || memcmp(buffer, expected, n * sizeof(*buffer))) {
+	    printf("%-6s differs from C reference\n", dsp->Name);
+	    ++errors;
+	}
+
+	sum = 0;
+	tick = AudioDspTime();
+	for (l = 0; l < loops; ++l) {
+	    sum += dsp->SumSquares(samples, n);
+	}
+	tick = AudioDspTime() - tick;
+	printf("%-6s sum squares %8.1f Msamples/s (%u)\n", dsp->Name,
+	    n * loops / (tick > 0 ? tick : 1), sum);
+
+	max_sample = 0;
+	tick = AudioDspTime();
+	for (l = 0; l < loops; ++l) {
+	    max_sample += dsp->MaxAbs(samples, n);
+	}
+	tick = AudioDspTime() - tick;
+	printf("%-6s max abs     %8.1f Msamples/s (%d)\n", dsp->Name,
+	    n * loops / (tick > 0 ? tick : 1), max_sample);
+
+	tick = AudioDspTime();
+	for (l = 0; l < loops; ++l) {
+	    dsp->Scale(buffer, n, 1000 - (l & 1));
+	}
+	tick = AudioDspTime() - tick;
+	printf("%-6s scale       %8.1f Msamples/s\n", dsp->Name,
+	    n * loops / (tick > 0 ? tick : 1));
+    }
+
+    free(buffer);
+    free(expected);
+    free(samples);
+
+    return errors;
+}
+
+/**
+**	Main entry point.
+**
+**	@param argc	number of arguments
+**	@param argv	arguments vector
+**
+**	@returns 1 if a kernel differs from the C reference, 0 otherwise.
+*/
+int main(int argc, char *const argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    srandom(1);
+    printf("using %s kernels\n", AudioDspInit());
+
+    return AudioDspBench() != 0;
+}
+
+#endif
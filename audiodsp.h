@@ -0,0 +1,38 @@
+///
+///	@file audiodsp.h	@brief Audio DSP kernel module header file
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+/// @addtogroup AudioDsp
+/// @{
+
+#define AUDIO_DSP_SHIFT 12		///< squares are summed >> this
+
+    /// select fastest kernels for the cpu
+extern const char *AudioDspInit(void);
+
+    /// sum squares of samples
+extern uint32_t AudioDspSumSquares(const int16_t *, int);
+
+    /// find loudest sample
+extern int AudioDspMaxAbs(const int16_t *, int);
+
+    /// scale samples by factor / 1000
+extern void AudioDspScale(int16_t *, int, int);
+
+/// @}
@@ -53,6 +53,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <libintl.h>
 #define _(str) gettext(str)		///< gettext shortcut
@@ -61,6 +62,7 @@
 #include <libavcodec/avcodec.h>
 #include <libavutil/mem.h>
 #include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
 // support old ffmpeg versions <1.0
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,18,102)
 #define AVCodecID CodecID
@@ -184,6 +186,196 @@ static enum AVPixelFormat Codec_get_format(AVCodecContext * video_ctx,
     return Video_get_format(decoder->HwDecoder, video_ctx, fmt);
 }
 
+//----------------------------------------------------------------------------
+//	Frame pool
+//----------------------------------------------------------------------------
+
+#define CODEC_FRAME_ALIGN 64		///< frame plane and stride alignment
+#define CODEC_HUGE_PAGE (2 * 1024 * 1024)	///< transparent huge page size
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int CodecPoolSize;		///< av_buffer_pool alloc size type
+#else
+typedef size_t CodecPoolSize;		///< av_buffer_pool alloc size type
+#endif
+
+///
+///	Frame buffer pool for software decoding.
+///
+///	One buffer holds all planes of a frame.  The pool only grows, the
+///	buffers of a larger resolution are reused for smaller frames.
+///
+struct _codec_frame_pool_
+{
+    pthread_mutex_t Mutex;		///< pool replace lock, frame threads
+    AVBufferPool *Pool;			///< pool of frame buffers
+    int Size;				///< size of pool buffers
+    atomic_t Requests;			///< number of buffers requested
+    atomic_t Misses;			///< number of buffers allocated
+};
+
+/**
+**	Free frame pool buffer.
+**
+**	@param opaque	unused
+**	@param data	buffer data
+*/
+static void CodecFramePoolFree( __attribute__ ((unused)) void *opaque,
+    uint8_t * data)
+{
+    free(data);
+}
+
+/**
+**	Allocate new frame pool buffer, called if the pool is empty.
+**
+**	Large buffers are huge page aligned and advised, this reduces the
+**	TLB misses of decoder and upload.
+**
+**	@param opaque	frame pool
+**	@param size	buffer size
+*/
+static AVBufferRef *CodecFramePoolAlloc(void *opaque, CodecPoolSize size)
+{
+    struct _codec_frame_pool_ *pool;
+    AVBufferRef *buf;
+    void *data;
+    size_t align;
+
+    pool = opaque;
+    atomic_inc(&pool->Misses);
+
+    align = size >= CODEC_HUGE_PAGE ? CODEC_HUGE_PAGE : CODEC_FRAME_ALIGN;
+    if (posix_memalign(&data, align, size)) {
+	return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (align == CODEC_HUGE_PAGE) {
+	madvise(data, size, MADV_HUGEPAGE);
+    }
+#endif
+    if (!(buf = av_buffer_create(data, size, CodecFramePoolFree, NULL, 0))) {
+	free(data);
+    }
+    return buf;
+}
+
+/**
+**	Allocate a new frame pool.
+*/
+static struct _codec_frame_pool_ *CodecFramePoolNew(void)
+{
+    struct _codec_frame_pool_ *pool;
+
+    if (!(pool = calloc(1, sizeof(*pool)))) {
+	Fatal(_("codec: can't allocate frame pool\n"));
+    }
+    pthread_mutex_init(&pool->Mutex, NULL);
+
+    return pool;
+}
+
+/**
+**	Deallocate a frame pool.
+**
+**	Buffers still in use are freed, when they are released.
+**
+**	@param pool	frame pool
+*/
+static void CodecFramePoolDel(struct _codec_frame_pool_ *pool)
+{
+    av_buffer_pool_uninit(&pool->Pool);
+    pthread_mutex_destroy(&pool->Mutex);
+    free(pool);
+}
+
+/**
+**	Get frame buffer from pool.
+**
+**	Planes and strides are aligned for aligned simd loads of decoder,
+**	upload and conversion.
+**
+**	@param pool		frame pool
+**	@param video_ctx	codec context
+**	@param frame		get buffer for this frame
+**
+**	@returns 0 or negative AVERROR code.
+*/
+static int CodecFramePoolGet(struct _codec_frame_pool_ *pool,
+    AVCodecContext * video_ctx, AVFrame * frame)
+{
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int linesizes[4];
+    uint8_t *data[4];
+    AVBufferRef *buf;
+    int width;
+    int height;
+    int size;
+    int i;
+
+    width = frame->width;
+    height = frame->height;
+    avcodec_align_dimensions2(video_ctx, &width, &height, linesize_align);
+    if (av_image_fill_linesizes(linesizes, frame->format, width) < 0) {
+	return AVERROR(EINVAL);
+    }
+    for (i = 0; i < 4; ++i) {
+	linesizes[i] = FFALIGN(linesizes[i], CODEC_FRAME_ALIGN);
+    }
+    // aligned strides keep the plane offsets aligned
+    size = av_image_fill_pointers(data, frame->format, height, NULL,
+	linesizes);
+    if (size < 0) {
+	return size;
+    }
+    size += CODEC_FRAME_ALIGN;		// simd overread
+
+    pthread_mutex_lock(&pool->Mutex);
+    if (size > pool->Size) {
+	if (size >= CODEC_HUGE_PAGE) {
+	    size = FFALIGN(size, CODEC_HUGE_PAGE);
+	}
+	Debug(3, "codec: frame pool %d -> %d bytes, %d requests %d misses\n",
+	    pool->Size, size, atomic_read(&pool->Requests),
+	    atomic_read(&pool->Misses));
+	// buffers in use are freed, when they are released
+	av_buffer_pool_uninit(&pool->Pool);
+	pool->Pool = av_buffer_pool_init2(size, pool, CodecFramePoolAlloc,
+	    NULL);
+	pool->Size = pool->Pool ? size : 0;
+    }
+    buf = pool->Pool ? av_buffer_pool_get(pool->Pool) : NULL;
+    pthread_mutex_unlock(&pool->Mutex);
+    if (!buf) {
+	return AVERROR(ENOMEM);
+    }
+    atomic_inc(&pool->Requests);
+
+    av_image_fill_pointers(frame->data, frame->format, height, buf->data,
+	linesizes);
+    for (i = 0; i < 4; ++i) {
+	frame->linesize[i] = linesizes[i];
+    }
+    frame->buf[0] = buf;
+    frame->extended_data = frame->data;
+
+    return 0;
+}
+
+/**
+**	Get frame pool statistics.
+**
+**	@param decoder		video decoder
+**	@param[out] hits	buffers reused from pool
+**	@param[out] misses	buffers newly allocated
+*/
+void CodecVideoGetPoolStats(const VideoDecoder * decoder, int *hits,
+    int *misses)
+{
+    *misses = atomic_read(&decoder->FramePool->Misses);
+    *hits = atomic_read(&decoder->FramePool->Requests) - *misses;
+}
+
 static void Codec_free_buffer(void *opaque, uint8_t *data);
 
 /**
@@ -268,6 +460,16 @@ static int Codec_get_buffer2(AVCodecContext * video_ctx, AVFrame * frame, int fl
 #endif
 	return 0;
     }
+    // software decoding: pooled frames, if decoder supports own buffers
+    if (video_ctx->codec->capabilities & AV_CODEC_CAP_DR1) {
+	const AVPixFmtDescriptor *desc;
+
+	desc = av_pix_fmt_desc_get(frame->format);
+	if (desc && !(desc->flags & (AV_PIX_FMT_FLAG_PAL |
+		    AV_PIX_FMT_FLAG_HWACCEL))) {
+	    return CodecFramePoolGet(decoder->FramePool, video_ctx, frame);
+	}
+    }
     //Debug(3, "codec: fallback to default get_buffer\n");
     return avcodec_default_get_buffer2(video_ctx, frame, flags);
 }
@@ -392,6 +594,7 @@ VideoDecoder *CodecVideoNewDecoder(VideoHwDecoder * hw_decoder)
 	Fatal(_("codec: can't allocate vodeo decoder\n"));
     }
     decoder->HwDecoder = hw_decoder;
+    decoder->FramePool = CodecFramePoolNew();
 
     return decoder;
 }
@@ -403,6 +606,7 @@ VideoDecoder *CodecVideoNewDecoder(VideoHwDecoder * hw_decoder)
 */
 void CodecVideoDelDecoder(VideoDecoder * decoder)
 {
+    CodecFramePoolDel(decoder->FramePool);
     free(decoder);
 }
 
@@ -692,7 +896,7 @@ int CodecVideoOpen(VideoDecoder * decoder, int codec_id)
         decoder->VideoCtx->hwaccel_flags |= AV_HWACCEL_FLAG_UNSAFE_OUTPUT;
     }
 #endif
-    // FIXME: own memory management for video frames.
+    // own memory management for video frames, see Codec_get_buffer2
     if (video_codec->capabilities & AV_CODEC_CAP_DR1) {
 	Debug(3, "codec: can use own buffer management\n");
     }
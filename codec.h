@@ -71,6 +71,7 @@ struct _video_decoder_
      AVCodecContext *VideoCtx;           ///< video codec context
      int FirstKeyFrame;                  ///< flag first frame
      AVFrame *Frame;                     ///< decoded video frame
+     struct _codec_frame_pool_ *FramePool; ///< software frame buffer pool
 #ifdef USE_AVFILTER
      /* deinterlace filter */
      AVFilterContext *buffersink_ctx;
@@ -142,6 +143,9 @@ extern int CodecVideoDecode(VideoDecoder *, const AVPacket *);
     /// Flush video buffers.
 extern void CodecVideoFlushBuffers(VideoDecoder *);
 
+    /// Get video frame pool statistics.
+extern void CodecVideoGetPoolStats(const VideoDecoder *, int *, int *);
+
     /// Allocate a new audio decoder context.
 extern AudioDecoder *CodecAudioNewDecoder(void);
 
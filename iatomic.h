@@ -94,4 +94,79 @@ typedef volatile int atomic_t;
 
 #endif
 
+//	acquire/release access, for single producer/single consumer indices.
+#if GCC_VERSION < 40700
+
+///
+///	Read value, later loads are not moved before it.
+///
+#define atomic_load_acquire(ptr) \
+    ({ __typeof__(*(ptr)) __v = *(volatile __typeof__(*(ptr)) *)(ptr); \
+    __sync_synchronize(); __v; })
+
+///
+///	Store value, earlier stores are not moved after it.
+///
+#define atomic_store_release(ptr, val) \
+    do { __sync_synchronize(); \
+    *(volatile __typeof__(*(ptr)) *)(ptr) = (val); } while (0)
+
+///
+///	Exchange value, returns old value, full memory barrier.
+///
+#define atomic_xchg(ptr, val) \
+    ({ __sync_synchronize(); __sync_lock_test_and_set(ptr, val); })
+
+///
+///	Later stores are not moved before earlier loads/stores.
+///
+#define atomic_release_fence() __sync_synchronize()
+
+///
+///	Earlier loads are not moved after later loads/stores.
+///
+#define atomic_acquire_fence() __sync_synchronize()
+
+///
+///	Full memory barrier.
+///
+#define atomic_fence() __sync_synchronize()
+
+#else
+
+///
+///	Read value, later loads are not moved before it.
+///
+#define atomic_load_acquire(ptr) \
+    __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+
+///
+///	Store value, earlier stores are not moved after it.
+///
+#define atomic_store_release(ptr, val) \
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+///
+///	Exchange value, returns old value, full memory barrier.
+///
+#define atomic_xchg(ptr, val) \
+    __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST)
+
+///
+///	Later stores are not moved before earlier loads/stores.
+///
+#define atomic_release_fence() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+///
+///	Earlier loads are not moved after later loads/stores.
+///
+#define atomic_acquire_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+///
+///	Full memory barrier.
+///
+#define atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif
+
 /// @}
@@ -1,5 +1,6 @@
 #define __STL_CONFIG_H
 #include <algorithm>
+#include <inttypes.h>
 #include "openglosd.h"
 #include "misc.h"
 #include <string>
@@ -17,6 +18,12 @@ extern "C"
 * Helpers
 ****************************************************************************************/
 
+static uint64_t NowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void ConvertColor(const GLint &colARGB, glm::vec4 &col) {
     col.a = ((colARGB & 0xFF000000) >> 24) / 255.0;
     col.r = ((colARGB & 0x00FF0000) >> 16) / 255.0;
@@ -260,7 +267,6 @@ bool cShader::CheckCompileErrors(GLuint object, bool program) {
     return true;
 }
 
-#define KERNING_UNKNOWN  (-10000)
 /****************************************************************************************
 * cOglGlyph
 ****************************************************************************************/
@@ -271,45 +277,57 @@ cOglGlyph::cOglGlyph(uint charCode, FT_BitmapGlyph ftGlyph) {
     width = ftGlyph->bitmap.width;
     height = ftGlyph->bitmap.rows;
     advanceX = ftGlyph->root.advance.x >> 16;   //value in 1/2^16 pixel
-    LoadTexture(ftGlyph);
+    texture = 0;
+    texX1 = texY1 = texX2 = texY2 = 0.0f;
 }
 
 cOglGlyph::~cOglGlyph(void) {
 
 }
 
-int cOglGlyph::GetKerningCache(uint prevSym) {
-    for (int i = kerningCache.Size(); --i > 0; ) {
-        if (kerningCache[i].prevSym == prevSym)
-            return kerningCache[i].kerning;
-    }
-    return KERNING_UNKNOWN;
+void cOglGlyph::SetAtlas(GLuint texture, int x, int y, int atlasSize) {
+    this->texture = texture;
+    texX1 = (GLfloat)x / atlasSize;
+    texY1 = (GLfloat)y / atlasSize;
+    texX2 = (GLfloat)(x + width) / atlasSize;
+    texY2 = (GLfloat)(y + height) / atlasSize;
 }
 
-void cOglGlyph::SetKerningCache(uint prevSym, int kerning) {
-    kerningCache.Append(tKerning(prevSym, kerning));
+/****************************************************************************************
+* cOglGlyphAtlas
+****************************************************************************************/
+cOglGlyphAtlas::cOglGlyphAtlas(void) {
+    size = 0;
+    x = 0;
+    y = 0;
+    rowHeight = 0;
 }
 
-void cOglGlyph::BindTexture(void) {
-    glBindTexture(GL_TEXTURE_2D, texture);
+cOglGlyphAtlas::~cOglGlyphAtlas(void) {
+    if (!textures.empty())
+        glDeleteTextures(textures.size(), textures.data());
 }
 
-void cOglGlyph::LoadTexture(FT_BitmapGlyph ftGlyph) {
-    // Disable byte-alignment restriction
+bool cOglGlyphAtlas::NewTexture(int minSize) {
+    GLint maxSize;
+    GLuint texture;
+    int newSize;
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    newSize = std::min(std::max(OGL_GLYPH_ATLAS_SIZE, minSize), (int)maxSize);
+    if (newSize < minSize) {
+        esyslog("[softhddev]ERROR: glyph too big for atlas %dpx", minSize);
+        return false;
+    }
+    // unused texels must be clear, filtering samples the neighbours
+    uint8_t *clear = (uint8_t *)calloc(newSize, newSize);
+    if (!clear)
+        return false;
+    size = newSize;
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RED,
-        ftGlyph->bitmap.width,
-        ftGlyph->bitmap.rows,
-        0,
-        GL_RED,
-        GL_UNSIGNED_BYTE,
-        ftGlyph->bitmap.buffer
-    );
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, size, size, 0, GL_RED, GL_UNSIGNED_BYTE, clear);
     // Set texture options
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -317,6 +335,44 @@ void cOglGlyph::LoadTexture(FT_BitmapGlyph ftGlyph) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glBindTexture(GL_TEXTURE_2D, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    free(clear);
+
+    textures.push_back(texture);
+    // one texel border around each glyph
+    x = 1;
+    y = 1;
+    rowHeight = 0;
+    return true;
+}
+
+bool cOglGlyphAtlas::Add(cOglGlyph *glyph, FT_BitmapGlyph ftGlyph) {
+    int w = ftGlyph->bitmap.width;
+    int h = ftGlyph->bitmap.rows;
+
+    if (textures.empty() && !NewTexture(std::max(w, h) + 2))
+        return false;
+    if (x + w + 1 > size) {     // next row
+        x = 1;
+        y += rowHeight + 1;
+        rowHeight = 0;
+    }
+    // glyph wider or higher than the atlas or atlas full
+    if ((w + 2 > size || h + 2 > size || y + h + 1 > size) && !NewTexture(std::max(w, h) + 2))
+        return false;
+
+    if (w && h) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, abs(ftGlyph->bitmap.pitch));
+        glBindTexture(GL_TEXTURE_2D, textures.back());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, ftGlyph->bitmap.buffer);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glyph->SetAtlas(textures.back(), x, y, size);
+    x += w + 1;
+    rowHeight = std::max(rowHeight, h);
+    return true;
 }
 
 
@@ -342,6 +398,8 @@ cOglFont::cOglFont(const char *fontName, int charHeight) : name(fontName) {
 }
 
 cOglFont::~cOglFont(void) {
+    for (auto &glyph : glyphCache)
+        delete glyph.second;
     FT_Done_Face(face);
 }
 
@@ -385,11 +443,9 @@ cOglGlyph* cOglFont::Glyph(uint charCode) const {
         charCode = 0x20;
 
     // Lookup in cache:
-    for (cOglGlyph *g = glyphCache.First(); g; g = glyphCache.Next(g)) {
-        if (g->CharCode() == charCode) {
-            return g;
-        }
-    }
+    auto cached = glyphCache.find(charCode);
+    if (cached != glyphCache.end())
+        return cached->second;
 
     FT_UInt glyph_index = FT_Get_Char_Index(face, charCode);
 
@@ -436,7 +492,9 @@ cOglGlyph* cOglFont::Glyph(uint charCode) const {
     }
 
     cOglGlyph *Glyph = new cOglGlyph(charCode, (FT_BitmapGlyph)ftGlyph);
-    glyphCache.Add(Glyph);
+    if (!atlas.Add(Glyph, (FT_BitmapGlyph)ftGlyph))
+        esyslog("[softhddev]ERROR: no atlas space for glyph %x", charCode);
+    glyphCache[charCode] = Glyph;
     FT_Done_Glyph(ftGlyph);
 
     return Glyph;
@@ -445,15 +503,18 @@ cOglGlyph* cOglFont::Glyph(uint charCode) const {
 int cOglFont::Kerning(cOglGlyph *glyph, uint prevSym) const {
     int kerning = 0;
     if (glyph && prevSym) {
-        kerning = glyph->GetKerningCache(prevSym);
-        if (kerning == KERNING_UNKNOWN) {
-            FT_Vector delta;
-            FT_UInt glyph_index = FT_Get_Char_Index(face, glyph->CharCode());
-            FT_UInt glyph_index_prev = FT_Get_Char_Index(face, prevSym);
-            FT_Get_Kerning(face, glyph_index_prev, glyph_index, FT_KERNING_DEFAULT, &delta);
-            kerning = delta.x / 64;
-            glyph->SetKerningCache(prevSym, kerning);
-        }
+        if (!FT_HAS_KERNING(face))
+            return 0;
+        uint64_t pair = (uint64_t)prevSym << 32 | glyph->CharCode();
+        auto cached = kerningCache.find(pair);
+        if (cached != kerningCache.end())
+            return cached->second;
+        FT_Vector delta;
+        FT_UInt glyph_index = FT_Get_Char_Index(face, glyph->CharCode());
+        FT_UInt glyph_index_prev = FT_Get_Char_Index(face, prevSym);
+        FT_Get_Kerning(face, glyph_index_prev, glyph_index, FT_KERNING_DEFAULT, &delta);
+        kerning = delta.x / 64;
+        kerningCache[pair] = kerning;
     }
     return kerning;
 }
@@ -719,10 +780,10 @@ bool cOglVb::Init(void) {
         drawMode = GL_TRIANGLE_FAN;
         shader = stRect;
     } else if (type == vbText) {
-        //Text VBO definition
+        //Text VBO definition, whole strings
         sizeVertex1 = 2;
         sizeVertex2 = 2;
-        numVertices = 6;
+        numVertices = 6 * OGL_TEXT_GLYPHS;
         drawMode = GL_TRIANGLES;
         shader = stText;
     }
@@ -798,7 +859,7 @@ void cOglVb::DrawArrays(int count) {
     if (!strcasecmp(VideoGetDriverName(), "va-api-egl"))
         eglWaitClient();	//preventing openGL crash on Intel
 #endif
-    glFlush();
+    // flushed by cOglThread after each run of commands on the same fb
 }
 
 
@@ -1263,12 +1324,17 @@ bool cOglCmdDrawText::Execute(void) {
     uint sym = 0;
     uint prevSym = 0;
     int kerning = 0;
+    // glyphs are batched, until the atlas texture changes
+    static GLfloat vertices[OGL_TEXT_GLYPHS * 6 * 4];
+    GLuint texture = 0;
+    int n = 0;
 
     for (int i = 0; symbols[i]; i++) {
         sym = symbols[i];
         cOglGlyph *g = f->Glyph(sym);
         if (!g) {
             esyslog("[softhddev]ERROR: could not load glyph %x", sym);
+            continue;
         }
 
         if ( limitX && xGlyph + g->AdvanceX() > limitX )
@@ -1277,30 +1343,45 @@ bool cOglCmdDrawText::Execute(void) {
         kerning = f->Kerning(g, prevSym);
         prevSym = sym;
 
+        if (n && (g->Texture() != texture || n == OGL_TEXT_GLYPHS)) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            VertexBuffers[vbText]->SetVertexData(vertices, n * 6);
+            VertexBuffers[vbText]->DrawArrays(n * 6);
+            n = 0;
+        }
+        texture = g->Texture();
+
         GLfloat x1 = xGlyph + kerning + g->BearingLeft();          //left
         GLfloat y1 = y + (fontHeight - bottom - g->BearingTop());  //top
         GLfloat x2 = x1 + g->Width();                              //right
         GLfloat y2 = y1 + g->Height();                             //bottom
-
-        GLfloat vertices[] = {
-            x1, y2,   0.0, 1.0,     // left bottom
-            x1, y1,   0.0, 0.0,     // left top
-            x2, y1,   1.0, 0.0,     // right top
-
-            x1, y2,   0.0, 1.0,     // left bottom
-            x2, y1,   1.0, 0.0,     // right top
-            x2, y2,   1.0, 1.0      // right bottom
+        GLfloat tx1 = g->TexX1();
+        GLfloat ty1 = g->TexY1();
+        GLfloat tx2 = g->TexX2();
+        GLfloat ty2 = g->TexY2();
+
+        GLfloat quad[] = {
+            x1, y2,   tx1, ty2,     // left bottom
+            x1, y1,   tx1, ty1,     // left top
+            x2, y1,   tx2, ty1,     // right top
+
+            x1, y2,   tx1, ty2,     // left bottom
+            x2, y1,   tx2, ty1,     // right top
+            x2, y2,   tx2, ty2      // right bottom
         };
-
-        g->BindTexture();
-        VertexBuffers[vbText]->SetVertexData(vertices);
-        VertexBuffers[vbText]->DrawArrays();
+        memcpy(vertices + n * 6 * 4, quad, sizeof(quad));
+        n++;
 
         xGlyph += kerning + g->AdvanceX();
 
         if ( xGlyph > fb->Width() - 1 )
             break;
     }
+    if (n) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        VertexBuffers[vbText]->SetVertexData(vertices, n * 6);
+        VertexBuffers[vbText]->DrawArrays(n * 6);
+    }
 
     glBindTexture(GL_TEXTURE_2D, 0);
     VertexBuffers[vbText]->Unbind();
@@ -1471,11 +1552,13 @@ bool cOglCmdDropImage::Execute(void) {
 * cOglThread
 ******************************************************************************/
 cOglThread::cOglThread(cCondWait *startWait, int maxCacheSize) : cThread("oglThread") {
-    stalled = false;
     memCached = 0;
     this->maxCacheSize = maxCacheSize * 1024 * 1024;
     this->startWait = startWait;
-    wait = new cCondWait();
+    queueHead = 0;
+    queueCount = 0;
+    queueWaits = 0;
+    statsStart = NowUs();
     maxTextureSize = 0;
     for (int i = 0; i < OGL_MAX_OSDIMAGES; i++) {
         imageCache[i].used = false;
@@ -1488,8 +1571,8 @@ cOglThread::cOglThread(cCondWait *startWait, int maxCacheSize) : cThread("oglThr
 }
 
 cOglThread::~cOglThread() {
-    delete wait;
-    wait = NULL;
+    for (int i = 0; i < queueCount; i++)
+        delete commands[(queueHead + i) % OGL_CMDQUEUE_SIZE];
 }
 
 void cOglThread::Stop(void) {
@@ -1499,26 +1582,41 @@ void cOglThread::Stop(void) {
         }
     }
     Cancel(2);
-    stalled = false;
 }
 
 void cOglThread::DoCmd(cOglCmd* cmd) {
-    while (stalled)
-        cCondWait::SleepMs(10);
+    cMutexLock lock(&queueMutex);
 
-    bool doSignal = false;
-    Lock();
-    if (commands.size() == 0)
-        doSignal = true;
-    commands.push(cmd);
-    Unlock();
-
-    if (commands.size() > OGL_CMDQUEUE_SIZE) {
-        stalled = true;
+    // back-pressure: wait until the worker has taken its next batch
+    while (queueCount == OGL_CMDQUEUE_SIZE && Running()) {
+        queueWaits++;
+        queueNotFull.TimedWait(queueMutex, 100);
+    }
+    if (queueCount == OGL_CMDQUEUE_SIZE) {
+        esyslog("[softhddev]OpenGL worker stopped, dropping \"%s\"", cmd->Description());
+        delete cmd;
+        return;
     }
+    commands[(queueHead + queueCount) % OGL_CMDQUEUE_SIZE] = cmd;
+    queueCount++;
+    queueNotEmpty.Broadcast();
+}
 
-    if (doSignal || stalled)
-        wait->Signal();
+void cOglThread::LogStats(void) {
+    uint64_t now = NowUs();
+
+    for (auto &stats : cmdStats) {
+        if (!stats.second.count)
+            continue;
+        dsyslog("[softhddev]OpenGL \"%s\": %d cmds, avg %" PRIu64 "us, max %" PRIu64 "us",
+            stats.first, stats.second.count,
+            stats.second.totalUs / stats.second.count, stats.second.maxUs);
+        stats.second = sOglCmdStats();
+    }
+    if (queueWaits)
+        dsyslog("[softhddev]OpenGL command queue full %d times", queueWaits);
+    queueWaits = 0;
+    statsStart = now;
 }
 
 int cOglThread::StoreImage(const cImage &image) {
@@ -1661,23 +1759,40 @@ void cOglThread::Action(void) {
 
     //now Thread is ready to do his job
     startWait->Signal();
-    stalled = false;
 
+    cOglCmd *batch[OGL_CMDQUEUE_SIZE];
     while(Running()) {
-      if (commands.empty()) {
-            wait->Wait(20);
-            continue;
+        int n;
+
+        // take all queued commands at once
+        queueMutex.Lock();
+        if (!queueCount)
+            queueNotEmpty.TimedWait(queueMutex, 20);
+        n = queueCount;
+        for (int i = 0; i < n; i++)
+            batch[i] = commands[(queueHead + i) % OGL_CMDQUEUE_SIZE];
+        queueHead = (queueHead + n) % OGL_CMDQUEUE_SIZE;
+        queueCount = 0;
+        if (n)
+            queueNotFull.Broadcast();
+        queueMutex.Unlock();
+
+        for (int i = 0; i < n; i++) {
+            uint64_t start = NowUs();
+            batch[i]->Execute();
+            // submit consecutive draws into the same fb together
+            if (i + 1 == n || batch[i + 1]->Fb() != batch[i]->Fb())
+                glFlush();
+            uint64_t us = NowUs() - start;
+
+            sOglCmdStats &stats = cmdStats[batch[i]->Description()];
+            stats.count++;
+            stats.totalUs += us;
+            stats.maxUs = std::max(stats.maxUs, us);
+            delete batch[i];
         }
-        Lock();
-        cOglCmd* cmd = commands.front();
-        commands.pop();
-        Unlock();
-        //uint64_t start = cTimeMs::Now();
-        cmd->Execute();
-        //esyslog("[softhddev]\"%s\", %dms, %d commands left, time %" PRIu64 "", cmd->Description(), (int)(cTimeMs::Now() - start), commands.size(), cTimeMs::Now());
-        delete cmd;
-        if (stalled && commands.size() < OGL_CMDQUEUE_SIZE / 2)
-            stalled = false;
+        if (NowUs() - statsStart >= OGL_STATS_INTERVAL * 1000)
+            LogStats();
     }
     dsyslog("[softhddev]Cleaning up OpenGL stuff");
     Cleanup();
@@ -26,8 +26,11 @@ const struct {
 #include FT_ERRORS_H
 
 
+#include <map>
 #include <memory>
-#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 //#include <vdr/plugin.h>
 #include <vdr/osd.h>
@@ -90,26 +93,17 @@ public:
 /****************************************************************************************
 * cOglGlyph
 ****************************************************************************************/
-class cOglGlyph : public cListObject {
+class cOglGlyph {
 private:
-    struct tKerning {
-        public:
-            tKerning(uint prevSym, GLfloat kerning = 0.0f)  {
-                this->prevSym = prevSym;
-                this->kerning = kerning;
-            }
-            uint prevSym;
-            GLfloat kerning;
-    };
     uint charCode;
     int bearingLeft;
     int bearingTop;
     int width;
     int height;
-    int advanceX;      
-    cVector<tKerning> kerningCache;
-    GLuint texture;
-    void LoadTexture(FT_BitmapGlyph ftGlyph);
+    int advanceX;
+    GLuint texture;         // atlas texture
+    GLfloat texX1, texY1;   // atlas coordinates
+    GLfloat texX2, texY2;
 public:
     cOglGlyph(uint charCode, FT_BitmapGlyph ftGlyph);
     virtual ~cOglGlyph();
@@ -119,9 +113,31 @@ public:
     int BearingTop(void) const { return bearingTop; }
     int Width(void) const { return width; }
     int Height(void) const { return height; }
-    int GetKerningCache(uint prevSym);
-    void SetKerningCache(uint prevSym, int kerning);
-    void BindTexture(void);
+    GLuint Texture(void) const { return texture; }
+    GLfloat TexX1(void) const { return texX1; }
+    GLfloat TexY1(void) const { return texY1; }
+    GLfloat TexX2(void) const { return texX2; }
+    GLfloat TexY2(void) const { return texY2; }
+    void SetAtlas(GLuint texture, int x, int y, int atlasSize);
+};
+
+/****************************************************************************************
+* cOglGlyphAtlas
+* Glyph textures of a font, packed in rows
+****************************************************************************************/
+#define OGL_GLYPH_ATLAS_SIZE 1024
+
+class cOglGlyphAtlas {
+private:
+    std::vector<GLuint> textures;
+    int size;               // size of current texture
+    int x, y;               // free position in current row
+    int rowHeight;
+    bool NewTexture(int minSize);
+public:
+    cOglGlyphAtlas(void);
+    virtual ~cOglGlyphAtlas(void);
+    bool Add(cOglGlyph *glyph, FT_BitmapGlyph ftGlyph);
 };
 
 /****************************************************************************************
@@ -137,7 +153,9 @@ private:
     static FT_Library ftLib;
     FT_Face face;
     static cList<cOglFont> *fonts;
-    mutable cList<cOglGlyph> glyphCache;
+    mutable std::unordered_map<uint, cOglGlyph*> glyphCache;
+    mutable std::unordered_map<uint64_t, int> kerningCache;    // (prevSym << 32) | sym
+    mutable cOglGlyphAtlas atlas;
     cOglFont(const char *fontName, int charHeight);
     static void Init(void);
 public:
@@ -247,6 +265,7 @@ protected:
 public:
     cOglCmd(cOglFb *fb) { this->fb = fb; };
     virtual ~cOglCmd(void) {};
+    cOglFb *Fb(void) { return fb; };
     virtual const char* Description(void) = 0;
     virtual bool Execute(void) = 0;
 };
@@ -354,6 +373,8 @@ public:
     virtual bool Execute(void);
 };
 
+#define OGL_TEXT_GLYPHS 256    // glyphs per text draw call
+
 class cOglCmdDrawText : public cOglCmd {
 private:
     GLint x, y;
@@ -420,13 +441,29 @@ public:
 ******************************************************************************/
 #define OGL_MAX_OSDIMAGES 256
 #define OGL_CMDQUEUE_SIZE 100
+#define OGL_STATS_INTERVAL 10000    // ms between command statistics
+
+struct sOglCmdStats {
+    int count;
+    uint64_t totalUs;
+    uint64_t maxUs;
+};
 
 class cOglThread : public cThread {
 private:
     cCondWait *startWait;
-    cCondWait *wait;
-    bool stalled;
-    std::queue<cOglCmd*> commands;
+    // bounded command ring, filled by DoCmd, drained in batches by Action
+    cMutex queueMutex;
+    cCondVar queueNotEmpty;
+    cCondVar queueNotFull;
+    cOglCmd *commands[OGL_CMDQUEUE_SIZE];
+    int queueHead;
+    int queueCount;
+    int queueWaits;         // DoCmd waited for free space
+    // keyed by the Description() literal, no string is built per command
+    std::map<const char *, sOglCmdStats> cmdStats;
+    uint64_t statsStart;
+    void LogStats(void);
     GLint maxTextureSize;
     sOglImage imageCache[OGL_MAX_OSDIMAGES];
     long memCached;
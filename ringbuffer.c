@@ -33,6 +33,8 @@
 #include "iatomic.h"
 #include "ringbuffer.h"
 
+#define RING_BUFFER_CACHE_LINE 64	///< cache line size
+
     /// ring buffer structure
 struct _ring_buffer_
 {
@@ -40,13 +42,43 @@ struct _ring_buffer_
     const char *BufferEnd;		///< end of buffer
     size_t Size;			///< bytes in buffer (for faster calc)
 
-    const char *ReadPointer;		///< only used by reader
-    char *WritePointer;			///< only used by writer
+    /// only used by reader, on its own cache line
+    const char *ReadPointer
+	__attribute__ ((aligned(RING_BUFFER_CACHE_LINE)));
+    size_t Read;			///< total bytes read, written by reader
 
-    /// The only thing modified by both
-    atomic_t Filled;			///< how many of the buffer is used
+    /// only used by writer, on its own cache line
+    char *WritePointer __attribute__ ((aligned(RING_BUFFER_CACHE_LINE)));
+    size_t Written;			///< total bytes written, by writer
 };
 
+//
+//	The indices are free running, the difference is the fill level.
+//	Each index is only modified by its owner and published with release,
+//	the other side reads it with acquire.  Buffer contents written before
+//	the release are visible after the acquire.
+//
+
+/**
+**	Get used bytes, as seen by the writer.
+**
+**	@param rb	Ring buffer.
+*/
+static inline size_t RingBufferWriterUsed(const RingBuffer * rb)
+{
+    return rb->Written - atomic_load_acquire(&rb->Read);
+}
+
+/**
+**	Get used bytes, as seen by the reader.
+**
+**	@param rb	Ring buffer.
+*/
+static inline size_t RingBufferReaderUsed(const RingBuffer * rb)
+{
+    return atomic_load_acquire(&rb->Written) - rb->Read;
+}
+
 /**
 **	Reset ring buffer pointers.
 **
@@ -56,7 +88,8 @@ void RingBufferReset(RingBuffer * rb)
 {
     rb->ReadPointer = rb->Buffer;
     rb->WritePointer = rb->Buffer;
-    atomic_set(&rb->Filled, 0);
+    atomic_store_release(&rb->Read, 0);
+    atomic_store_release(&rb->Written, 0);
 }
 
 /**
@@ -71,8 +104,9 @@ RingBuffer *RingBufferNew(size_t size)
 {
     RingBuffer *rb;
 
-    if (!(rb = malloc(sizeof(*rb)))) {	// allocate structure
-	return rb;
+    // allocate structure, cache line aligned for the indices
+    if (posix_memalign((void **)&rb, RING_BUFFER_CACHE_LINE, sizeof(*rb))) {
+	return NULL;
     }
     if (!(rb->Buffer = malloc(size))) {	// allocate buffer
 	free(rb);
@@ -107,7 +141,7 @@ size_t RingBufferWriteAdvance(RingBuffer * rb, size_t cnt)
 {
     size_t n;
 
-    n = rb->Size - atomic_read(&rb->Filled);
+    n = rb->Size - RingBufferWriterUsed(rb);
     if (cnt > n) {			// not enough space
 	cnt = n;
     }
@@ -126,9 +160,9 @@ size_t RingBufferWriteAdvance(RingBuffer * rb, size_t cnt)
     }
 
     //
-    //	Only atomic modification!
+    //	Publish the written bytes
     //
-    atomic_add(cnt, &rb->Filled);
+    atomic_store_release(&rb->Written, rb->Written + cnt);
     return cnt;
 }
 
@@ -146,7 +180,7 @@ size_t RingBufferWrite(RingBuffer * rb, const void *buf, size_t cnt)
 {
     size_t n;
 
-    n = rb->Size - atomic_read(&rb->Filled);
+    n = rb->Size - RingBufferWriterUsed(rb);
     if (cnt > n) {			// not enough space
 	cnt = n;
     }
@@ -169,9 +203,9 @@ size_t RingBufferWrite(RingBuffer * rb, const void *buf, size_t cnt)
     }
 
     //
-    //	Only atomic modification!
+    //	Publish the written bytes
     //
-    atomic_add(cnt, &rb->Filled);
+    atomic_store_release(&rb->Written, rb->Written + cnt);
     return cnt;
 }
 
@@ -190,7 +224,7 @@ size_t RingBufferGetWritePointer(RingBuffer * rb, void **wp)
     size_t cnt;
 
     //	Total free bytes available in ring buffer
-    cnt = rb->Size - atomic_read(&rb->Filled);
+    cnt = rb->Size - RingBufferWriterUsed(rb);
 
     *wp = rb->WritePointer;
 
@@ -216,7 +250,7 @@ size_t RingBufferReadAdvance(RingBuffer * rb, size_t cnt)
 {
     size_t n;
 
-    n = atomic_read(&rb->Filled);
+    n = RingBufferReaderUsed(rb);
     if (cnt > n) {			// not enough filled
 	cnt = n;
     }
@@ -235,9 +269,9 @@ size_t RingBufferReadAdvance(RingBuffer * rb, size_t cnt)
     }
 
     //
-    //	Only atomic modification!
+    //	Release the read bytes to the writer
     //
-    atomic_sub(cnt, &rb->Filled);
+    atomic_store_release(&rb->Read, rb->Read + cnt);
     return cnt;
 }
 
@@ -254,7 +288,7 @@ size_t RingBufferRead(RingBuffer * rb, void *buf, size_t cnt)
 {
     size_t n;
 
-    n = atomic_read(&rb->Filled);
+    n = RingBufferReaderUsed(rb);
     if (cnt > n) {			// not enough filled
 	cnt = n;
     }
@@ -277,9 +311,9 @@ size_t RingBufferRead(RingBuffer * rb, void *buf, size_t cnt)
     }
 
     //
-    //	Only atomic modification!
+    //	Release the read bytes to the writer
     //
-    atomic_sub(cnt, &rb->Filled);
+    atomic_store_release(&rb->Read, rb->Read + cnt);
     return cnt;
 }
 
@@ -298,7 +332,7 @@ size_t RingBufferGetReadPointer(RingBuffer * rb, const void **rp)
     size_t cnt;
 
     //	Total used bytes in ring buffer
-    cnt = atomic_read(&rb->Filled);
+    cnt = RingBufferReaderUsed(rb);
 
     *rp = rb->ReadPointer;
 
@@ -321,17 +355,23 @@ size_t RingBufferGetReadPointer(RingBuffer * rb, const void **rp)
 */
 size_t RingBufferFreeBytes(RingBuffer * rb)
 {
-    return rb->Size - atomic_read(&rb->Filled);
+    return rb->Size - RingBufferUsedBytes(rb);
 }
 
 /**
 **	Get used bytes in ring buffer.
 **
+**	Can be called from any thread.
+**
 **	@param rb	Ring buffer.
 **
 **	@returns	Number of bytes used in buffer.
 */
 size_t RingBufferUsedBytes(RingBuffer * rb)
 {
-    return atomic_read(&rb->Filled);
+    size_t read;
+
+    // read index first, the write index can only grow meanwhile
+    read = atomic_load_acquire(&rb->Read);
+    return atomic_load_acquire(&rb->Written) - read;
 }
@@ -132,6 +132,36 @@ color.rgb = pow(color.rgb, vec3(1.0/2.4));\n\
 out_color = color;\n\
 }\n"};
 
+// cpu decoded Y, U and V planes, V uses the chroma coordinates
+char fragment_planar[] = {"\
+%s\n\
+#define texture1D texture\n\
+#define texture3D texture\n\
+precision highp float;\
+layout(location = 0) out vec4 out_color;\n\
+in vec2 texcoord0;\n\
+in vec2 texcoord1;\n\
+in vec2 texcoord2;\n\
+in vec2 texcoord3;\n\
+in vec2 texcoord4;\n\
+in vec2 texcoord5;\n\
+uniform mat3 colormatrix;\n\
+uniform vec3 colormatrix_c;\n\
+uniform sampler2D texture0;\n\
+uniform sampler2D texture1;\n\
+uniform sampler2D texture2;\n\
+uniform float texture_scale;\n\
+void main() {\n\
+vec4 color; // = vec4(0.0, 0.0, 0.0, 1.0);\n\
+color.r = texture_scale * vec4(texture(texture0, texcoord0)).r;\n\
+color.g = texture_scale * vec4(texture(texture1, texcoord1)).r;\n\
+color.b = texture_scale * vec4(texture(texture2, texcoord1)).r;\n\
+// color conversion\n\
+color.rgb = mat3(colormatrix) * color.rgb  + colormatrix_c;\n\
+color.a = 1.0;\n\
+out_color = color;\n\
+}\n"};
+
 /* Color conversion matrix: RGB = m * YUV + c
  * m is in row-major matrix, with m[row][col], e.g.:
  *     [ a11 a12 a13 ]     float m[3][3] = { { a11, a12, a13 },
@@ -293,7 +323,7 @@ static GLuint sc_generate_osd(GLuint gl_prog) {
     return gl_prog; 
 }
 
-static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
+static GLuint sc_generate_program(GLuint gl_prog, enum AVColorSpace colorspace, int planar)
 {
     char vname[80];
     int n, r;
@@ -330,6 +360,9 @@ static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
 		break;
 	}
 	
+	if (planar)		// cpu decoded planes, no cms
+		Fragment = fragment_planar;
+
 	Debug(3,"vor create\n");
 	gl_prog = glCreateProgram();
 	for (n=0;n<4;n++) {
@@ -345,7 +378,7 @@ static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
 	Debug(3,"Try compile fragment %s\n", Versions[n]);
 
 	frag = malloc(charsize(Fragment, Versions[n]));
-	sprintf(frag, fragment, Versions[n]);
+	sprintf(frag, planar ? Fragment : fragment, Versions[n]);
 	r = compile_attach_shader(gl_prog, GL_FRAGMENT_SHADER, frag);
 	free(frag);
 	if (!r) return 0;
@@ -371,7 +404,7 @@ static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
 	  glProgramUniform3fv(gl_prog,gl_colormatrix_c,1,c);
 	GlCheck();
 	
-	if (colorspace == AVCOL_SPC_BT2020_NCL) {
+	if (colorspace == AVCOL_SPC_BT2020_NCL && !planar) {
 		cmsLoc = glGetUniformLocation(gl_prog,"cms_matrix");
 		if (cmsLoc != -1)
 		  glProgramUniformMatrix3fv(gl_prog,cmsLoc,1,0,cms);
@@ -381,6 +414,16 @@ static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
     return gl_prog;
 }
 
+static GLuint sc_generate(GLuint gl_prog, enum AVColorSpace colorspace)
+{
+    return sc_generate_program(gl_prog, colorspace, 0);
+}
+
+static GLuint sc_generate_planar(GLuint gl_prog, enum AVColorSpace colorspace)
+{
+    return sc_generate_program(gl_prog, colorspace, 1);
+}
+
 static void render_pass_quad(int flip, float xcrop, float ycrop)
 {
     struct vertex va[4];
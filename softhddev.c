@@ -49,6 +49,9 @@
 #include <libavfilter/buffersrc.h>
 #endif
 #include <libavutil/mem.h>
+#ifdef USE_JPEG
+#include <jpeglib.h>
+#endif
 // support old ffmpeg versions <1.0
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,18,102)
 #define AVCodecID CodecID
@@ -76,6 +79,7 @@
 #include "audio.h"
 #include "video.h"
 #include "codec.h"
+#include "startcode.h"
 
 #ifdef noDEBUG
 static int DumpH264(const uint8_t * data, int size);
@@ -87,6 +91,8 @@ static void DumpMpeg(const uint8_t * data, int size);
 //////////////////////////////////////////////////////////////////////////////
 
 extern int ConfigAudioBufferTime;	///< config size ms of audio buffer
+extern int ConfigVideoBufferSize;	///< config size MiB of video buffer
+extern int ConfigVideoBufferTime;	///< config size ms of video buffer
 extern int DisableOglOsd;		///< disable OpenGL OSD
 extern char ConfigVideoClearOnSwitch;	///< clear decoder on channel switch
 extern volatile char AudioStarted;
@@ -573,8 +579,11 @@ void ResetChannelId(void)
 //	Video
 //////////////////////////////////////////////////////////////////////////////
 
-#define VIDEO_BUFFER_SIZE (512 * 1024 * 2)	///< video PES buffer default size
-#define VIDEO_PACKET_MAX 192		///< max number of video packets
+#define VIDEO_PACKET_MAX 512		///< max number of video packets
+#define VIDEO_BUFFER_SIZE 64		///< default video buffer size in MiB
+#define VIDEO_BUFFER_TIME 4000		///< default video buffer time in ms
+#define VIDEO_POOL_MIN (64 * 1024)	///< smallest pooled packet buffer
+#define VIDEO_POOL_MAX 10		///< number of packet buffer pools
 
 /**
 **	Video output stream device structure.	Parser, decoder, display.
@@ -603,11 +612,17 @@ struct __video_stream__
 
     enum AVCodecID CodecIDRb[VIDEO_PACKET_MAX];	///< codec ids in ring buffer
     AVPacket PacketRb[VIDEO_PACKET_MAX];	///< PES packet ring buffer
+    /// packet buffer pools, VIDEO_POOL_MIN << n bytes each
+    AVBufferPool *PacketPool[VIDEO_POOL_MAX];
     int StartCodeState;			///< last three bytes start code state
 
     int PacketWrite;			///< ring buffer write pointer
     int PacketRead;			///< ring buffer read pointer
     atomic_t PacketsFilled;		///< how many of the ring buffer is used
+    atomic_t BytesFilled;		///< bytes of packets in ring buffer
+    int64_t PtsRb[VIDEO_PACKET_MAX];	///< last known pts of packets
+    int64_t LastPts;			///< last valid pts put in ring buffer
+    int64_t MaxPts;			///< highest pts put in ring buffer
 };
 
 static VideoStream MyVideoStream[1];	///< normal video stream
@@ -632,6 +647,9 @@ static volatile char Usr1Signal;	///< true got usr1 signal
 /**
 **	Initialize video packet ringbuffer.
 **
+**	Packets get their buffers from size class pools on demand, the
+**	buffers are returned to the pool after decode.
+**
 **	@param stream	video stream
 */
 static void VideoPacketInit(VideoStream * stream)
@@ -642,14 +660,23 @@ static void VideoPacketInit(VideoStream * stream)
 	AVPacket *avpkt;
 
 	avpkt = &stream->PacketRb[i];
-	// build a clean ffmpeg av packet
-	if (av_new_packet(avpkt, VIDEO_BUFFER_SIZE)) {
+	// build a clean ffmpeg av packet without buffer
+	memset(avpkt, 0, sizeof(*avpkt));
+	avpkt->pts = AV_NOPTS_VALUE;
+	avpkt->dts = AV_NOPTS_VALUE;
+    }
+    for (i = 0; i < VIDEO_POOL_MAX; ++i) {
+	if (!(stream->PacketPool[i] =
+		av_buffer_pool_init(VIDEO_POOL_MIN << i, NULL))) {
 	    Fatal(_("[softhddev] out of memory\n"));
 	}
     }
 
     atomic_set(&stream->PacketsFilled, 0);
+    atomic_set(&stream->BytesFilled, 0);
     stream->PacketRead = stream->PacketWrite = 0;
+    stream->LastPts = AV_NOPTS_VALUE;
+    stream->MaxPts = AV_NOPTS_VALUE;
 }
 
 /**
@@ -662,6 +689,7 @@ static void VideoPacketExit(VideoStream * stream)
     int i;
 
     atomic_set(&stream->PacketsFilled, 0);
+    atomic_set(&stream->BytesFilled, 0);
 
     for (i = 0; i < VIDEO_PACKET_MAX; ++i) {
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(56,28,1)
@@ -670,6 +698,44 @@ static void VideoPacketExit(VideoStream * stream)
 	av_packet_unref(&stream->PacketRb[i]);
 #endif
     }
+    // buffers still used by the decoder are freed with their last reference
+    for (i = 0; i < VIDEO_POOL_MAX; ++i) {
+	av_buffer_pool_uninit(&stream->PacketPool[i]);
+    }
+}
+
+/**
+**	Give packet a bigger buffer from the pools.
+**
+**	@param stream	video stream
+**	@param avpkt	packet to grow, filled bytes are kept
+**	@param size	needed size without padding
+**
+**	@returns 0 on success, -1 packet too big or out of memory.
+*/
+static int VideoPacketGrow(VideoStream * stream, AVPacket * avpkt, int size)
+{
+    AVBufferRef *buf;
+    int i;
+
+    // find smallest size class
+    for (i = 0; i < VIDEO_POOL_MAX; ++i) {
+	if (size + FF_INPUT_BUFFER_PADDING_SIZE <= VIDEO_POOL_MIN << i) {
+	    break;
+	}
+    }
+    if (i == VIDEO_POOL_MAX || !stream->PacketPool[i]
+	|| !(buf = av_buffer_pool_get(stream->PacketPool[i]))) {
+	return -1;
+    }
+    if (avpkt->size) {
+	memcpy(buf->data, avpkt->data, avpkt->size);
+    }
+    av_buffer_unref(&avpkt->buf);
+    avpkt->buf = buf;
+    avpkt->data = buf->data;
+
+    return 0;
 }
 
 /**
@@ -688,35 +754,30 @@ static void VideoEnqueue(VideoStream * stream, int64_t pts, const void *data,
     // Debug(3, "video: enqueue %d\n", size);
 
     avpkt = &stream->PacketRb[stream->PacketWrite];
-    if (!avpkt->stream_index) {		// add pts only for first added
+    if (!avpkt->size) {			// add pts only for first added
 	avpkt->pts = pts;
     }
-    if (avpkt->stream_index + size >= avpkt->size) {
+    // buffer reserves FF_INPUT_BUFFER_PADDING_SIZE
+    if (!avpkt->buf
+	|| avpkt->size + size + FF_INPUT_BUFFER_PADDING_SIZE >
+	(int)avpkt->buf->size) {
 
-	Debug(4,"video: packet %d buffer too small for %d\n", stream->PacketWrite,
-	    avpkt->stream_index + size);
+	Debug(4, "video: packet %d buffer too small for %d\n",
+	    stream->PacketWrite, avpkt->size + size);
 
-	// new + grow reserves FF_INPUT_BUFFER_PADDING_SIZE
-	if (av_grow_packet(avpkt, ((size + VIDEO_BUFFER_SIZE / 2)
-		/ (VIDEO_BUFFER_SIZE / 2)) * (VIDEO_BUFFER_SIZE / 2))) {
-	    avpkt->stream_index = 0;
+	if (VideoPacketGrow(stream, avpkt, avpkt->size + size)) {
+	    Error(_("video: can't get packet buffer for %d bytes\n"),
+		avpkt->size + size);
+	    avpkt->size = 0;
 	    return;
 	}
-#ifdef DEBUG
-	if (avpkt->size <= avpkt->stream_index + size) {
-	    fprintf(stderr, "%d %d %d\n", avpkt->size, avpkt->stream_index,
-		size);
-	    fflush(stderr);
-	    abort();
-	}
-#endif
     }
 
-    memcpy(avpkt->data + avpkt->stream_index, data, size);
-    avpkt->stream_index += size;
+    memcpy(avpkt->data + avpkt->size, data, size);
+    avpkt->size += size;
 #ifdef DEBUG
-    if (avpkt->stream_index > VideoMaxPacketSize) {
-	VideoMaxPacketSize = avpkt->stream_index;
+    if (avpkt->size > VideoMaxPacketSize) {
+	VideoMaxPacketSize = avpkt->size;
 	Debug(4, "video: max used PES packet size: %d\n", VideoMaxPacketSize);
     }
 #endif
@@ -735,7 +796,7 @@ static void VideoResetPacket(VideoStream * stream)
 
     stream->CodecIDRb[stream->PacketWrite] = AV_CODEC_ID_NONE;
     avpkt = &stream->PacketRb[stream->PacketWrite];
-    avpkt->stream_index = 0;
+    avpkt->size = 0;			// keep buffer for reuse
     avpkt->pts = AV_NOPTS_VALUE;
     avpkt->dts = AV_NOPTS_VALUE;
 }
@@ -751,7 +812,7 @@ static void VideoNextPacket(VideoStream * stream, int codec_id)
     AVPacket *avpkt;
 
     avpkt = &stream->PacketRb[stream->PacketWrite];
-    if (!avpkt->stream_index) {		// ignore empty packets
+    if (!avpkt->size) {			// ignore empty packets
 	if (codec_id != AV_CODEC_ID_NONE) {
 	    return;
 	}
@@ -761,17 +822,32 @@ static void VideoNextPacket(VideoStream * stream, int codec_id)
     if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 1) {
 	// no free slot available drop last packet
 	Error(_("video: no empty slot in packet ringbuffer\n"));
-	avpkt->stream_index = 0;
+	avpkt->size = 0;
 	if (codec_id == AV_CODEC_ID_NONE) {
 	    Debug(3, "video: possible stream change loss\n");
 	}
 	return;
     }
     // clear area for decoder, always enough space allocated
-    memset(avpkt->data + avpkt->stream_index, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    if (avpkt->buf) {
+	memset(avpkt->data + avpkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    }
 
     stream->CodecIDRb[stream->PacketWrite] = codec_id;
-    //DumpH264(avpkt->data, avpkt->stream_index);
+    //DumpH264(avpkt->data, avpkt->size);
+
+    // remember pts for the buffer time, split packets have no pts
+    if (avpkt->pts != (int64_t) AV_NOPTS_VALUE) {
+	stream->LastPts = avpkt->pts;
+	// reordered B-frames are behind, a big jump back is a discontinuity
+	if (stream->MaxPts == (int64_t) AV_NOPTS_VALUE
+	    || ((stream->MaxPts - avpkt->pts) & 0x1FFFFFFFFLL) >
+	    60 * 1000 * 90) {
+	    stream->MaxPts = avpkt->pts;
+	}
+    }
+    stream->PtsRb[stream->PacketWrite] = stream->LastPts;
+    atomic_add(avpkt->size, &stream->BytesFilled);
 
     // advance packet write
     stream->PacketWrite = (stream->PacketWrite + 1) % VIDEO_PACKET_MAX;
@@ -808,7 +884,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts,
     int first;
 
     // first scan
-    first = !stream->PacketRb[stream->PacketWrite].stream_index;
+    first = !stream->PacketRb[stream->PacketWrite].size;
     p = data;
     n = size;
 
@@ -829,7 +905,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts,
 #ifdef DEBUG
 		fprintf(stderr, "last: %d start\n", stream->StartCodeState);
 #endif
-		stream->PacketRb[stream->PacketWrite].stream_index -= 3;
+		stream->PacketRb[stream->PacketWrite].size -= 3;
 		VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
 		VideoEnqueue(stream, pts, startcode, 3);
 		first = p[0] == 0xb3;
@@ -846,7 +922,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts,
 #ifdef DEBUG
 		fprintf(stderr, "last: %d start\n", stream->StartCodeState);
 #endif
-		stream->PacketRb[stream->PacketWrite].stream_index -= 2;
+		stream->PacketRb[stream->PacketWrite].size -= 2;
 		VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
 		VideoEnqueue(stream, pts, startcode, 2);
 		first = p[1] == 0xb3;
@@ -863,7 +939,7 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts,
 #ifdef DEBUG
 		fprintf(stderr, "last: %d start\n", stream->StartCodeState);
 #endif
-		stream->PacketRb[stream->PacketWrite].stream_index -= 1;
+		stream->PacketRb[stream->PacketWrite].size -= 1;
 		VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
 		VideoEnqueue(stream, pts, startcode, 1);
 		first = p[2] == 0xb3;
@@ -878,6 +954,17 @@ static void VideoMpegEnqueue(VideoStream * stream, int64_t pts,
     // b3 b4 b8 00 b5 ... 00 b5 ...
 
     while (n > 3) {
+	int r;
+
+	// jump to next start code prefix, keep the border bytes
+	if ((r = StartCodeFind(p, n - 1)) < 0) {
+	    p += n - 3;
+	    n = 3;
+	    break;
+	}
+	p += r;
+	n -= r;
+
 	if (0 && !p[0] && !p[1] && p[2] == 0x01) {
 	    fprintf(stderr, " %02x", p[3]);
 	}
@@ -973,6 +1060,15 @@ static void FixPacketForFFMpeg(VideoDecoder * vdecoder, AVPacket * avpkt)
 #endif
 
     while (n > 3) {
+	int r;
+
+	// jump to next start code prefix
+	if ((r = StartCodeFind(p, n - 1)) < 0) {
+	    break;
+	}
+	p += r;
+	n -= r;
+
 #if STILL_DEBUG>1
 	if (InStillPicture && !p[0] && !p[1] && p[2] == 0x01) {
 	    fprintf(stderr, " %02x", p[3]);
@@ -1096,6 +1192,7 @@ int VideoPollInput(VideoStream * stream)
     }
     if (stream->ClearBuffers) {		// clear buffer request
 	atomic_set(&stream->PacketsFilled, 0);
+	atomic_set(&stream->BytesFilled, 0);
 	stream->PacketRead = stream->PacketWrite;
 	// FIXME: ->Decoder already checked
 	if (stream->Decoder) {
@@ -1124,7 +1221,6 @@ int VideoDecodeInput(VideoStream * stream)
 {
     int filled;
     AVPacket *avpkt;
-    int saved_size;
 
     if (!stream->Decoder) {		// closing
 #ifdef DEBUG
@@ -1140,6 +1236,7 @@ int VideoDecodeInput(VideoStream * stream)
     }
     if (stream->ClearBuffers) {		// clear buffer request
 	atomic_set(&stream->PacketsFilled, 0);
+	atomic_set(&stream->BytesFilled, 0);
 	stream->PacketRead = stream->PacketWrite;
 	// FIXME: ->Decoder already checked
 	if (stream->Decoder) {
@@ -1246,11 +1343,6 @@ int VideoDecodeInput(VideoStream * stream)
 	default:
 	    break;
     }
-    // avcodec_decode_video2 needs size
-    saved_size = avpkt->size;
-    avpkt->size = avpkt->stream_index;
-    avpkt->stream_index = 0;
-
 #ifdef USE_PIP
     //fprintf(stderr, "[");
     //DumpMpeg(avpkt->data, avpkt->size);
@@ -1279,9 +1371,15 @@ int VideoDecodeInput(VideoStream * stream)
 	CodecVideoDecode(stream->Decoder, avpkt);
     }
 #endif
-    avpkt->size = saved_size;
 
   skip:
+    atomic_sub(avpkt->size, &stream->BytesFilled);
+    // return buffer to the pool, the decoder holds its own reference
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(56,28,1)
+    av_free_packet(avpkt);
+#else
+    av_packet_unref(avpkt);
+#endif
     // advance packet read
     stream->PacketRead = (stream->PacketRead + 1) % VIDEO_PACKET_MAX;
     atomic_dec(&stream->PacketsFilled);
@@ -1299,6 +1397,62 @@ int VideoGetBuffers(const VideoStream * stream)
     return atomic_read(&stream->PacketsFilled);
 }
 
+/**
+**	Get presentation time of video buffers.
+**
+**	PTS span from the oldest packet in the ring buffer to the highest
+**	pts enqueued, the newest packet is often a reordered B-frame.
+**
+**	@param stream	video stream
+**
+**	@returns buffered time in ms, 0 if unknown.
+*/
+int VideoGetBuffersTime(const VideoStream * stream)
+{
+    int filled;
+    int64_t first;
+    int64_t last;
+    int64_t diff;
+
+    if (!(filled = atomic_read(&stream->PacketsFilled))) {
+	return 0;
+    }
+    first = stream->PtsRb[stream->PacketRead];
+    last = stream->MaxPts;
+    if (first == (int64_t) AV_NOPTS_VALUE
+	|| last == (int64_t) AV_NOPTS_VALUE) {
+	return 0;
+    }
+    diff = (last - first) & 0x1FFFFFFFFLL;	// 33 bit pts wrap
+    // stream discontinuity
+    if (diff > 60 * 1000 * 90) {
+	return 0;
+    }
+    return diff / 90;
+}
+
+/**
+**	Check if video buffers are full.
+**
+**	Limited by the number of packets, the bytes and the presentation
+**	time, so that low and high bitrate streams buffer the same time.
+**
+**	@param stream	video stream
+*/
+static int VideoBuffersFull(const VideoStream * stream)
+{
+    int size;
+    int time;
+
+    size = ConfigVideoBufferSize ? ConfigVideoBufferSize : VIDEO_BUFFER_SIZE;
+    time = ConfigVideoBufferTime ? ConfigVideoBufferTime : VIDEO_BUFFER_TIME;
+
+    return atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10
+	|| atomic_read(&stream->BytesFilled) >= size * 1024 * 1024
+	// trick speed packets are far apart in presentation time
+	|| (!stream->TrickSpeed && VideoGetBuffersTime(stream) >= time);
+}
+
 /**
 **	Try video start.
 **
@@ -1572,24 +1726,11 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 #define IS_AVS3(x) (((x[4]>>3)&1) && !((x[4]>>2)&1) && ((x[6]>>4)&1) && !((x[6]>>3)&1))
 
     if (is_start) {			// start of pes packet
-	if (pesdx->Index && pesdx->Skip) {
-	    // copy remaining bytes down
-	    pesdx->Index -= pesdx->Skip;
-	    memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip, pesdx->Index);
-	    pesdx->Skip = 0;
-	}
 	pesdx->State = PES_SYNC;
 	pesdx->HeaderIndex = 0;
 	pesdx->PTS = AV_NOPTS_VALUE;	// reset if not yet used
 	pesdx->DTS = AV_NOPTS_VALUE;
     }
-    // cleanup, if too much cruft
-    if (pesdx->Skip > PES_MAX_PAYLOAD / 2) {
-	// copy remaining bytes down
-	pesdx->Index -= pesdx->Skip;
-	memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip, pesdx->Index);
-	pesdx->Skip = 0;
-    }
 
     p = data;
     do {
@@ -1618,20 +1759,43 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 #endif
 
 	    case PES_INIT:		// find start of packet
-		// FIXME: increase if needed the buffer
-
-		// fill buffer
-		n = pesdx->Size - pesdx->Index;
-		if (n > size) {
+		if (av == TS_PES_VIDEO) {
+		    // video is enqueued directly from the ts payload
+		    pesdx->Index = 0;
+		    pesdx->Skip = 0;
+		    q = p;
 		    n = size;
-		}
-		memcpy(pesdx->Buffer + pesdx->Index, p, n);
-		pesdx->Index += n;
-		p += n;
-		size -= n;
+		    p += n;
+		    size = 0;
+		} else {
+		    if (pesdx->Skip == pesdx->Index) {
+			// all bytes used, restart at buffer begin
+			pesdx->Index = 0;
+			pesdx->Skip = 0;
+		    } else if (pesdx->Index + size > pesdx->Size) {
+			// buffer end reached, copy the incomplete frame down
+			pesdx->Index -= pesdx->Skip;
+			memmove(pesdx->Buffer, pesdx->Buffer + pesdx->Skip,
+			    pesdx->Index);
+			pesdx->Skip = 0;
+			if (pesdx->Index == pesdx->Size) {
+			    Debug(3, "pesdemux: buffer full, dropped\n");
+			    pesdx->Index = 0;
+			}
+		    }
+		    // fill buffer
+		    n = pesdx->Size - pesdx->Index;
+		    if (n > size) {
+			n = size;
+		    }
+		    memcpy(pesdx->Buffer + pesdx->Index, p, n);
+		    pesdx->Index += n;
+		    p += n;
+		    size -= n;
 
-		q = pesdx->Buffer + pesdx->Skip;
-		n = pesdx->Index - pesdx->Skip;
+		    q = pesdx->Buffer + pesdx->Skip;
+		    n = pesdx->Index - pesdx->Skip;
+		}
 
 		if(av == TS_PES_AUDIO){ //audio
 			while (n >= 5) {
@@ -1710,10 +1874,12 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 				Debug(4, "pesdemux: skip @%d %02x\n", pesdx->Skip,
 				    q[0]);
 			    }
-			    // try next byte
-			    ++pesdx->Skip;
-			    ++q;
-			    --n;
+			    // skip to next sync word candidate
+			    r = StartCodeSyncFind(q + 1, n - 1);
+			    r = r < 0 ? n - 1 : r + 1;
+			    pesdx->Skip += r;
+			    q += r;
+			    n -= r;
 			}
 		} else if (av == TS_PES_VIDEO) { //video
 			const uint8_t *check;
@@ -1740,9 +1906,9 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 #endif
 			// H264 NAL AUD Access Unit Delimiter (0x00) 0x00 0x00 0x01 0x09
 			// and next start code
-			if (is_start && z >= 2 && check[0] == 0x01 && check[1] == 0x09 && !check[3] && !check[4] &&
+			if (is_start && l > 6 && z >= 2 && check[0] == 0x01 && check[1] == 0x09 && !check[3] && !check[4] &&
 			//wait I-frame for detect h.264
-			(check[2] == 0x10 || check[2] == 0xf0 || MyVideoStream->CodecID == AV_CODEC_ID_H264) && l > 6) {
+			(check[2] == 0x10 || check[2] == 0xf0 || MyVideoStream->CodecID == AV_CODEC_ID_H264)) {
 			// old PES HDTV recording z == 2 -> stronger check!
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_H264) {
 #ifdef DUMP_TRICKSPEED
@@ -1772,7 +1938,7 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 
 				    // 1-5=SLICE 6=SEI 7=SPS 8=PPS
 				    // NAL SPS sequence parameter set
-				    if ((check[7] & 0x1F) == 0x07) {
+				    if (l > 7 && (check[7] & 0x1F) == 0x07) {
 					VideoNextPacket(MyVideoStream, AV_CODEC_ID_H264);
 					VideoEnqueue(MyVideoStream, AV_NOPTS_VALUE, seq_end_h264,
 					sizeof(seq_end_h264));
@@ -1791,7 +1957,7 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 			    break;
 			}
 			// HEVC Codec
-			if (VideoHardwareDecoder != HWhevcOff && is_start && z >= 2 && check[0] == 0x01 && check[1] == 0x46 &&
+			if (VideoHardwareDecoder != HWhevcOff && is_start && l > 4 && z >= 2 && check[0] == 0x01 && check[1] == 0x46 &&
 			(check[3] == 0x10 || check[3] == 0x50 || MyVideoStream->CodecID == AV_CODEC_ID_HEVC)) {
 			// old PES HDTV recording z == 2 -> stronger check!
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_HEVC) {
@@ -1808,7 +1974,7 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 			}
 			// PES start code 0x00 0x00 0x01 0x00|(0xb3 0xXX 0xXX)
 			if (is_start && z > 1 && check[0] == 0x01 && ((!check[1] && MyVideoStream->CodecID ==
-                        AV_CODEC_ID_MPEG2VIDEO) || (check[1] == 0xb3 && check[2] && check[3]))) {
+                        AV_CODEC_ID_MPEG2VIDEO) || (l > 3 && check[1] == 0xb3 && check[2] && check[3]))) {
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
 				VideoNextPacket(MyVideoStream, AV_CODEC_ID_MPEG2VIDEO);
 			    } else {
@@ -1834,8 +2000,8 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 			}
 
 			// CAVS Codec
-			if (is_start && z >= 2 && check[0] == 0x01 && ((check[1] == 0xb0 && check[2] == 0x48) ||
-			(MyVideoStream->CodecID == AV_CODEC_ID_CAVS && check[1] == 0xb6 &&  check[2] && check[3]))) {
+			if (is_start && z >= 2 && check[0] == 0x01 && ((l > 2 && check[1] == 0xb0 && check[2] == 0x48) ||
+			(MyVideoStream->CodecID == AV_CODEC_ID_CAVS && l > 3 && check[1] == 0xb6 &&  check[2] && check[3]))) {
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_CAVS) {
 				VideoNextPacket(MyVideoStream, AV_CODEC_ID_CAVS);
 			    } else {
@@ -1850,10 +2016,10 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 			}
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58,21,100)
 			// AVS2 Codec
-			if (is_start && z >= 2 && check[0] == 0x01 && ((check[1] == 0xb0 && !IS_AVS3(check) &&
+			if (is_start && z >= 2 && check[0] == 0x01 && ((l > 6 && check[1] == 0xb0 && !IS_AVS3(check) &&
 			(check[2] == 0x20 || check[2] == 0x22 || check[2] == 0x30 || check[2] == 0x32)) ||
 			(MyVideoStream->CodecID == AV_CODEC_ID_AVS2 &&
-			(check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[2] == 0xb5 || check[2] == 0xb7)))) {
+			(check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[1] == 0xb5 || check[1] == 0xb7)))) {
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_AVS2) {
 				VideoNextPacket(MyVideoStream, AV_CODEC_ID_AVS2);
 			    } else {
@@ -1869,10 +2035,10 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 #endif
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58,109,100)
 			// AVS3 Codec
-			if (is_start && z >= 2 && check[0] == 0x01 && ((check[1] == 0xb0 && IS_AVS3(check) &&
+			if (is_start && z >= 2 && check[0] == 0x01 && ((l > 6 && check[1] == 0xb0 && IS_AVS3(check) &&
 			(check[2] == 0x20 || check[2] == 0x22)) ||
 			(MyVideoStream->CodecID == AV_CODEC_ID_AVS3 &&
-			(check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[2] == 0xb5 || check[2] == 0xb7)))) {
+			(check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[1] == 0xb5 || check[1] == 0xb7)))) {
 			    if (MyVideoStream->CodecID == AV_CODEC_ID_AVS3) {
 				VideoNextPacket(MyVideoStream, AV_CODEC_ID_AVS3);
 			    } else {
@@ -2108,6 +2274,8 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
     } while (size > 0);
 }
 
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 //	Transport stream demux
 //////////////////////////////////////////////////////////////////////////////
@@ -2116,11 +2284,20 @@ static void PesParse(PesDemux * pesdx, const uint8_t * data, int size,
 #define TS_PACKET_SIZE	188
     /// Transport stream packet sync byte
 #define TS_PACKET_SYNC	0x47
+    /// Number of transport stream packet ids
+#define TS_PID_MAX	8192
+    /// Max. number of payload handlers of a demuxer
+#define TS_HANDLER_MAX	4
 
 ///
-///	transport stream demuxer typedef.
+///	transport stream payload handler.
 ///
-typedef struct _ts_demux_ TsDemux;
+typedef struct _ts_handler_
+{
+    TsPayloadHandler Payload;		///< called with packet payload
+    TsFlushHandler Flush;		///< called if payload is lost
+    void *Opaque;			///< handler private data
+} TsHandler;
 
 ///
 ///	transport stream demuxer structure.
@@ -2128,86 +2305,306 @@ typedef struct _ts_demux_ TsDemux;
 struct _ts_demux_
 {
     int Packets;			///< packets between PCR
+    int Discontinuities;		///< number of lost packets detected
+    int Handlers;			///< number of used handlers
+    int AnyHandler;			///< handler + 1 for all other pids
+    TsHandler Handler[TS_HANDLER_MAX];	///< payload handlers
+    uint8_t PidHandler[TS_PID_MAX];	///< pid to handler + 1
+    int8_t CC[TS_PID_MAX];		///< last continuity counter, -1 none
 };
 
-static PesDemux PesDemuxer[2];	///< PES demuxer
+///
+///	Reset transport stream demuxer continuity state.
+///
+///	@param tsdx	transport stream demuxer
+///
+void TsDemuxReset(TsDemux * tsdx)
+{
+    memset(tsdx->CC, -1, sizeof(tsdx->CC));
+}
+
+///
+///	Initialize transport stream demuxer.
+///
+///	@param tsdx	transport stream demuxer
+///
+static void TsDemuxInit(TsDemux * tsdx)
+{
+    memset(tsdx, 0, sizeof(*tsdx));
+    TsDemuxReset(tsdx);
+}
+
+///
+///	Allocate new transport stream demuxer.
+///
+TsDemux *TsDemuxNew(void)
+{
+    TsDemux *tsdx;
+
+    if (!(tsdx = malloc(sizeof(*tsdx)))) {
+	Error(_("tsdemux: out of memory\n"));
+	return NULL;
+    }
+    TsDemuxInit(tsdx);
+    return tsdx;
+}
+
+///
+///	Free transport stream demuxer.
+///
+///	@param tsdx	transport stream demuxer
+///
+void TsDemuxDel(TsDemux * tsdx)
+{
+    free(tsdx);
+}
+
+///
+///	Add payload handler for a packet id.
+///
+///	@param tsdx	transport stream demuxer
+///	@param pid	packet id or #TS_PID_ANY for all other packet ids
+///	@param payload	called with the payload of each packet
+///	@param flush	called if payload of an unfinished pes packet is lost
+///	@param opaque	private data of the handlers
+///
+///	@returns -1 if there are too many handlers or the pid is invalid.
+///
+int TsDemuxAddPid(TsDemux * tsdx, int pid, TsPayloadHandler payload,
+    TsFlushHandler flush, void *opaque)
+{
+    TsHandler *handler;
+
+    if (tsdx->Handlers >= TS_HANDLER_MAX || pid >= TS_PID_MAX || (pid < 0
+	    && pid != TS_PID_ANY)) {
+	Error(_("tsdemux: can't add handler for pid %d\n"), pid);
+	return -1;
+    }
+    handler = &tsdx->Handler[tsdx->Handlers++];
+    handler->Payload = payload;
+    handler->Flush = flush;
+    handler->Opaque = opaque;
+    if (pid == TS_PID_ANY) {
+	tsdx->AnyHandler = tsdx->Handlers;
+    } else {
+	tsdx->PidHandler[pid] = tsdx->Handlers;
+    }
+    return 0;
+}
+
+///
+///	Count packets with valid sync byte.
+///
+///	The sync bytes of the whole buffer are checked in one branch free
+///	loop, only a broken buffer is searched for the bad packet.
+///
+///	@param data	buffer of transport stream packets
+///	@param n	number of packets in buffer
+///
+///	@returns number of packets upto the first bad one.
+///
+static int TsSyncCheck(const uint8_t * data, int n)
+{
+    unsigned bad;
+    int i;
+
+    bad = 0;
+    for (i = 0; i < n; ++i) {
+	bad |= data[i * TS_PACKET_SIZE] ^ TS_PACKET_SYNC;
+    }
+    if (!bad) {
+	return n;
+    }
+    for (i = 0; data[i * TS_PACKET_SIZE] == TS_PACKET_SYNC; ++i) {
+    }
+    return i;
+}
+
+///
+///	Find next packet start after lost sync.
+///
+///	@param data	buffer of transport stream packets
+///	@param size	size of buffer
+///
+///	@returns number of bytes to skip.
+///
+static int TsResync(const uint8_t * data, int size)
+{
+    const uint8_t *p;
+
+    p = data + 1;
+    while ((p = memchr(p, TS_PACKET_SYNC, data + size - p))) {
+	// need sync byte of next packet too
+	if (p + TS_PACKET_SIZE == data + size || (p + TS_PACKET_SIZE < data + size
+		&& p[TS_PACKET_SIZE] == TS_PACKET_SYNC)) {
+	    return p - data;
+	}
+	++p;
+    }
+    return size;
+}
 
 ///
 ///	Transport stream demuxer.
 ///
+///	Demuxes a buffer of packets, the payload of each packet is given to
+///	the handler of its packet id.  Lost packets are detected with the
+///	continuity counter, only the unfinished pes packet of the pid is
+///	flushed.
+///
 ///	@param tsdx	transport stream demuxer
 ///	@param data	buffer of transport stream packets
 ///	@param size	size of buffer
-///	@param av	audio/video packet
 ///
 ///	@returns number of bytes consumed from buffer.
 ///
-static int TsDemuxer(TsDemux * tsdx, const uint8_t * data, int size, int av)
+int TsDemuxPackets(TsDemux * tsdx, const uint8_t * data, int size)
 {
     const uint8_t *p;
+    const uint8_t *e;
+    const uint8_t *end;
 
     p = data;
-    while (size >= TS_PACKET_SIZE) {
+    end = data + size;
+    while (end - p >= TS_PACKET_SIZE) {
+	e = p + TsSyncCheck(p, (end - p) / TS_PACKET_SIZE) * TS_PACKET_SIZE;
+	for (; p < e; p += TS_PACKET_SIZE) {
+	    const TsHandler *handler;
+	    int pid;
+	    int h;
+	    int payload;
+	    int cc;
+	    int discontinuity;
+
+	    ++tsdx->Packets;
+	    pid = (p[1] & 0x1F) << 8 | p[2];
+	    if (!(h = tsdx->PidHandler[pid]) && !(h = tsdx->AnyHandler)) {
+		continue;		// not our pid
+	    }
+	    handler = &tsdx->Handler[h - 1];
+
+	    if (p[1] & 0x80) {		// error indicator
+		// packet is lost, handled by the continuity check
+		Debug(3, "tsdemux: transport error\n");
+		continue;
+	    }
 #ifdef DEBUG
-	int pid;
+	    Debug(4, "tsdemux: PID: %#04x%s%s\n", pid,
+		p[1] & 0x40 ? " start" : "", p[3] & 0x10 ? " payload" : "");
 #endif
-	int payload;
+	    // skip adaptation field
+	    discontinuity = 0;
+	    switch (p[3] & 0x30) {	// adaption field
+		case 0x00:		// reserved
+		case 0x20:		// adaptation field only
+		default:
+		    continue;
+		case 0x10:		// only payload
+		    payload = 4;
+		    break;
+		case 0x30:		// skip adapation field
+		    payload = 5 + p[4];
+		    // illegal length, ignore packet
+		    if (payload >= TS_PACKET_SIZE) {
+			Debug(3, "tsdemux: illegal adaption field length\n");
+			continue;
+		    }
+		    // discontinuity indicator
+		    discontinuity = p[4] && p[5] & 0x80;
+		    break;
+	    }
 
-	if (p[0] != TS_PACKET_SYNC) {
-	    Error(_("tsdemux: transport stream out of sync\n"));
-	    // FIXME: kill all buffers
-	    return size;
-	}
-	++tsdx->Packets;
-	if (p[1] & 0x80) {		// error indicator
-	    Debug(3, "tsdemux: transport error\n");
-	    // FIXME: kill all buffers
-	    goto next_packet;
-	}
-#ifdef DEBUG
-	pid = (p[1] & 0x1F) << 8 | p[2];
-	Debug(4, "tsdemux: PID: %#04x%s%s\n", pid, p[1] & 0x40 ? " start" : "",
-	    p[3] & 0x10 ? " payload" : "");
-#endif
-	// skip adaptation field
-	switch (p[3] & 0x30) {		// adaption field
-	    case 0x00:			// reserved
-	    case 0x20:			// adaptation field only
-	    default:
-		goto next_packet;
-	    case 0x10:			// only payload
-		payload = 4;
-		break;
-	    case 0x30:			// skip adapation field
-		payload = 5 + p[4];
-		// illegal length, ignore packet
-		if (payload >= TS_PACKET_SIZE) {
-		    Debug(3, "tsdemux: illegal adaption field length\n");
-		    goto next_packet;
+	    //	check continuity
+	    cc = p[3] & 0x0F;		// continuity counter
+	    if (tsdx->CC[pid] >= 0 && !discontinuity) {
+		if (cc == tsdx->CC[pid]) {
+		    Debug(4, "tsdemux: PID %#04x duplicate packet\n", pid);
+		    continue;
 		}
-		break;
+		if (cc != ((tsdx->CC[pid] + 1) & 0x0F)) {
+		    Debug(3, "tsdemux: PID %#04x discontinuity %d, expected %d\n",
+			pid, cc, (tsdx->CC[pid] + 1) & 0x0F);
+		    ++tsdx->Discontinuities;
+		    // lost packets are the tail of the unfinished pes packet,
+		    // drop it also if a new pes packet starts here
+		    if (handler->Flush) {
+			handler->Flush(handler->Opaque);
+		    }
+		}
+	    }
+	    tsdx->CC[pid] = cc;
+
+	    handler->Payload(handler->Opaque, p + payload,
+		TS_PACKET_SIZE - payload, p[1] & 0x40);
+	}
+	if (end - p >= TS_PACKET_SIZE) {	// stopped at bad sync byte
+	    Error(_("tsdemux: transport stream out of sync\n"));
+	    p += TsResync(p, end - p);
 	}
+    }
 
-	PesParse(&PesDemuxer[av], p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40, av);
+    return p - data;
+}
 
-#if 0
-	int tmp;
+#ifdef USE_TS
 
-	//	check continuity
-	tmp = p[3] & 0x0F;		// continuity counter
-	if (((tsdx->CC + 1) & 0x0F) != tmp) {
-	    Debug(3, "tsdemux: OUT OF SYNC: %d %d\n", tmp, tsdx->CC);
-	    //TS discontinuity (received 8, expected 0) for PID
-	}
-	tsdx->CC = tmp;
-#endif
+static PesDemux PesDemuxer[2];		///< PES demuxer
+static TsDemux TsPesDemuxer[2];		///< TS demuxer
 
-      next_packet:
-	p += TS_PACKET_SIZE;
-	size -= TS_PACKET_SIZE;
+///
+///	Transport stream payload handler for the pes demuxer.
+///
+///	@param opaque	packetized elementary stream demuxer
+///	@param data	payload data of transport stream
+///	@param size	number of payload data bytes
+///	@param is_start flag, start of pes packet
+///
+static void TsPesPayload(void *opaque, const uint8_t * data, int size,
+    int is_start)
+{
+    PesDemux *pesdx;
+
+    pesdx = opaque;
+    PesParse(pesdx, data, size, is_start, pesdx - PesDemuxer);
+}
+
+///
+///	Drop unfinished pes packet, after transport stream packets are lost.
+///
+///	@param opaque	packetized elementary stream demuxer
+///
+static void TsPesFlush(void *opaque)
+{
+    PesDemux *pesdx;
+
+    pesdx = opaque;
+    if (pesdx->State == PES_INIT && pesdx - PesDemuxer == TS_PES_VIDEO) {
+	// payload of the damaged packet is already in the video buffers
+	pesdx->videoIndex = 0;
+	VideoResetPacket(MyVideoStream);
     }
+    // skip upto next pes packet start
+    pesdx->State = PES_SKIP;
+    pesdx->Index = 0;
+    pesdx->Skip = 0;
+    pesdx->PTS = AV_NOPTS_VALUE;
+    pesdx->DTS = AV_NOPTS_VALUE;
+}
 
-    return p - data;
+///
+///	Initialize transport stream demuxer for audio and video.
+///
+static void TsInit(void)
+{
+    int av;
+
+    for (av = TS_PES_VIDEO; av <= TS_PES_AUDIO; ++av) {
+	PesInit(&PesDemuxer[av]);
+	TsDemuxInit(&TsPesDemuxer[av]);
+	// vdr gives us only packets of the selected pid
+	TsDemuxAddPid(&TsPesDemuxer[av], TS_PID_ANY, TsPesPayload, TsPesFlush,
+	    &PesDemuxer[av]);
+    }
 }
 
 #endif
@@ -2462,16 +2859,14 @@ int PlayAudio(const uint8_t * data, int size, uint8_t id)
 **
 **	VDR can have buffered data belonging to previous channel!
 **
-**	@param data	data of exactly one complete TS packet
-**	@param size	size of TS packet (always TS_PACKET_SIZE)
+**	@param data	data of complete TS packets
+**	@param size	size of TS packets (multiple of TS_PACKET_SIZE)
 **
 **	@returns number of bytes consumed;
 */
 
 int PlayTsAudio(const uint8_t * data, int size)
 {
-    static TsDemux tsdx[1];
-
     if (SkipAudio || !MyAudioDecoder) {	// skip audio
 	return size;
     }
@@ -2488,6 +2883,7 @@ int PlayTsAudio(const uint8_t * data, int size)
 	AudioChannelID = -1;
 	NewAudioStream = 0;
 	PesReset(&PesDemuxer[TS_PES_AUDIO]);
+	TsDemuxReset(&TsPesDemuxer[TS_PES_AUDIO]);
     }
     // hard limit buffer full: don't overrun audio buffers on replay
     if (AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE) {
@@ -2501,7 +2897,7 @@ int PlayTsAudio(const uint8_t * data, int size)
     }
 #endif
 
-    return TsDemuxer(tsdx, data, size, TS_PES_AUDIO);
+    return TsDemuxPackets(&TsPesDemuxer[TS_PES_AUDIO], data, size);
 }
 #endif
 
@@ -2575,7 +2971,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 	return size;
     }
     // hard limit buffer full: needed for replay
-    if (atomic_read(&stream->PacketsFilled) >= VIDEO_PACKET_MAX - 10) {
+    if (VideoBuffersFull(stream)) {
 	return 0;
     }
 #ifdef USE_SOFTLIMIT
@@ -2609,7 +3005,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 
     // H264 NAL AUD Access Unit Delimiter (0x00) 0x00 0x00 0x01 0x09
     // and next start code
-    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01
+    if ((data[6] & 0xC0) == 0x80 && l > 6 && z >= 2 && check[0] == 0x01
 	&& check[1] == 0x09 && !check[3] && !check[4] &&
 	(check[2] == 0x10 || check[2] == 0xf0 || MyVideoStream->CodecID == AV_CODEC_ID_H264)) {
 	// old PES HDTV recording z == 2 -> stronger check!
@@ -2642,7 +3038,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 
 		// 1-5=SLICE 6=SEI 7=SPS 8=PPS
 		// NAL SPS sequence parameter set
-		if ((check[7] & 0x1F) == 0x07) {
+		if (l > 7 && (check[7] & 0x1F) == 0x07) {
 		    VideoNextPacket(stream, AV_CODEC_ID_H264);
 		    VideoEnqueue(stream, AV_NOPTS_VALUE, seq_end_h264,
 			sizeof(seq_end_h264));
@@ -2659,7 +3055,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 	return size;
     }
     // HEVC Codec
-    if (VideoHardwareDecoder != HWhevcOff && (data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && check[1] == 0x46 &&
+    if (VideoHardwareDecoder != HWhevcOff && (data[6] & 0xC0) == 0x80 && l > 4 && z >= 2 && check[0] == 0x01 && check[1] == 0x46 &&
     (check[3] == 0x10 || check[3] == 0x50 || stream->CodecID == AV_CODEC_ID_HEVC)) {
 	// old PES HDTV recording z == 2 -> stronger check!
 	if (stream->CodecID == AV_CODEC_ID_HEVC) {
@@ -2675,7 +3071,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 
     // PES start code 0x00 0x00 0x01 0x00|0xb3
     if ((data[6] & 0xC0) == 0x80 && z > 1 && check[0] == 0x01 && ((!check[1] && stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) ||
-    (check[1] == 0xb3 && check[2] && check[3]))) {
+    (l > 3 && check[1] == 0xb3 && check[2] && check[3]))) {
 	if (stream->CodecID == AV_CODEC_ID_MPEG2VIDEO) {
 	    VideoNextPacket(stream, AV_CODEC_ID_MPEG2VIDEO);
 	} else {
@@ -2697,7 +3093,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
     }
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58,21,100)
     // AVS2 Codec
-    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && ((check[1] == 0xb0 && !IS_AVS3(check) &&
+    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && ((l > 6 && check[1] == 0xb0 && !IS_AVS3(check) &&
     (check[2] == 0x20 || check[2] == 0x22 || check[2] == 0x30 || check[2] == 0x32)) ||
     (stream->CodecID == AV_CODEC_ID_AVS2 &&
     (check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[1] == 0xb5 || check[1] == 0xb7)))) {
@@ -2714,7 +3110,7 @@ int PlayVideo3(VideoStream * stream, const uint8_t * data, int size)
 #endif
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58,109,100)
     // AVS3 Codec
-    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && ((check[1] == 0xb0 && IS_AVS3(check) &&
+    if ((data[6] & 0xC0) == 0x80 && z >= 2 && check[0] == 0x01 && ((l > 6 && check[1] == 0xb0 && IS_AVS3(check) &&
     (check[2] == 0x20 || check[2] == 0x22)) ||
     (stream->CodecID == AV_CODEC_ID_AVS3 &&
     (check[1] == 0xb1 || check[1] == 0xb3 || check[1] == 0xb6 || check[1] == 0xb5 || check[1] == 0xb7)))) {
@@ -2797,16 +3193,14 @@ int PlayVideo(const uint8_t * data, int size)
 **
 **	VDR can have buffered data belonging to previous channel!
 **
-**	@param data	data of exactly one complete TS packet
-**	@param size	size of TS packet (always TS_PACKET_SIZE)
+**	@param data	data of complete TS packets
+**	@param size	size of TS packets (multiple of TS_PACKET_SIZE)
 **
 **	@returns number of bytes consumed;
 */
 
 int PlayTsVideo(const uint8_t * data, int size)
 {
-    static TsDemux tsdx[1];
-
     if (!MyVideoStream->Decoder) {// no x11 video started
 	return size;
     }
@@ -2827,10 +3221,13 @@ int PlayTsVideo(const uint8_t * data, int size)
 	MyVideoStream->ClosingStream = 1;
 	MyVideoStream->NewStream = 0;
 	PesReset(&PesDemuxer[TS_PES_VIDEO]);
+	TsDemuxReset(&TsPesDemuxer[TS_PES_VIDEO]);
     }
     // hard limit buffer full: needed for replay
-    if (atomic_read(&MyVideoStream->PacketsFilled) >= VIDEO_PACKET_MAX - 10) {
-	Debug(4,"[softhddev] PlayTsVideo Filled %d\n",MyVideoStream->PacketsFilled);
+    if (VideoBuffersFull(MyVideoStream)) {
+	Debug(4, "[softhddev] PlayTsVideo Filled %d %dms\n",
+	    VideoGetBuffers(MyVideoStream),
+	    VideoGetBuffersTime(MyVideoStream));
 	return 0;
     }
 #ifdef USE_SOFTLIMIT
@@ -2840,7 +3237,7 @@ int PlayTsVideo(const uint8_t * data, int size)
 	return 0;
     }
 #endif
-    return TsDemuxer(tsdx, data, size, TS_PES_VIDEO);
+    return TsDemuxPackets(&TsPesDemuxer[TS_PES_VIDEO], data, size);
 }
 #endif
 
@@ -2849,13 +3246,16 @@ int PlayTsVideo(const uint8_t * data, int size)
     /// call VDR support function
 extern uint8_t *CreateJpeg(uint8_t *, int *, int, int, int);
 
-#if defined(USE_JPEG) && JPEG_LIB_VERSION >= 80
+#if defined(USE_JPEG) && (JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED))
 
 /**
-**	Create a jpeg image in memory.
+**	Create a jpeg image in memory from raw YCbCr 4:2:0 planes.
 **
-**	@param image		raw RGB image
-**	@param raw_size		size of raw image
+**	Raw data input skips the color conversion and down sampling of
+**	libjpeg.
+**
+**	@param image		Y, Cb and Cr planes padded to 16x16 blocks
+**	@param pitch		pitch of Y plane, Cb and Cr planes have half
 **	@param size[out]	size of jpeg image
 **	@param quality		jpeg quality
 **	@param width		number of horizontal pixels in image
@@ -2863,15 +3263,23 @@ extern uint8_t *CreateJpeg(uint8_t *, int *, int, int, int);
 **
 **	@returns allocated jpeg image.
 */
-uint8_t *CreateJpeg(uint8_t * image, int raw_size, int *size, int quality,
-    int width, int height)
+static uint8_t *CreateJpegYCbCr(uint8_t * image, int pitch, int *size,
+    int quality, int width, int height)
 {
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr jerr;
-    JSAMPROW row_ptr[1];
-    int row_stride;
+    JSAMPROW y_rows[16];
+    JSAMPROW cb_rows[8];
+    JSAMPROW cr_rows[8];
+    JSAMPARRAY planes[3];
+    uint8_t *cb;
+    uint8_t *cr;
     uint8_t *outbuf;
     long unsigned int outsize;
+    int i;
+
+    cb = image + pitch * ((height + 15) & ~15);
+    cr = cb + pitch / 2 * ((height + 15) & ~15) / 2;
 
     outbuf = NULL;
     outsize = 0;
@@ -2881,17 +3289,33 @@ uint8_t *CreateJpeg(uint8_t * image, int raw_size, int *size, int quality,
 
     cinfo.image_width = width;
     cinfo.image_height = height;
-    cinfo.input_components = raw_size / height / width;
-    cinfo.in_color_space = JCS_RGB;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
 
     jpeg_set_defaults(&cinfo);
     jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
     jpeg_start_compress(&cinfo, TRUE);
 
-    row_stride = width * 3;
+    planes[0] = y_rows;
+    planes[1] = cb_rows;
+    planes[2] = cr_rows;
+    // one iMCU row of 16 luma lines per call, planes are padded for it
     while (cinfo.next_scanline < cinfo.image_height) {
-	row_ptr[0] = &image[cinfo.next_scanline * row_stride];
-	jpeg_write_scanlines(&cinfo, row_ptr, 1);
+	for (i = 0; i < 16; ++i) {
+	    y_rows[i] = image + (cinfo.next_scanline + i) * pitch;
+	}
+	for (i = 0; i < 8; ++i) {
+	    cb_rows[i] = cb + (cinfo.next_scanline / 2 + i) * (pitch / 2);
+	    cr_rows[i] = cr + (cinfo.next_scanline / 2 + i) * (pitch / 2);
+	}
+	jpeg_write_raw_data(&cinfo, planes, 16);
     }
 
     jpeg_finish_compress(&cinfo);
@@ -2918,6 +3342,21 @@ uint8_t *GrabImage(int *size, int jpeg, int quality, int width, int height)
 	uint8_t *image;
 	int raw_size;
 
+#if defined(USE_JPEG) && (JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED))
+	int pitch;
+
+	// scaled and converted in one pass, no rgb round trip
+	image = VideoGrabYCbCr(&width, &height, &pitch);
+	if (image) {
+	    uint8_t *jpg_image;
+
+	    jpg_image =
+		CreateJpegYCbCr(image, pitch, size, quality, width, height);
+
+	    free(image);
+	    return jpg_image;
+	}
+#endif
 	raw_size = 0;
 	image = VideoGrab(&raw_size, &width, &height, 0);
 	if (image) {			// can fail, suspended, ...
@@ -3067,6 +3506,7 @@ void Clear(void)
     int i;
 
     VideoResetPacket(MyVideoStream);	// terminate work
+    MyVideoStream->MaxPts = AV_NOPTS_VALUE;
     MyVideoStream->ClearBuffers = 1;
     if (!SkipAudio) {
 	AudioFlushBuffers();
@@ -3079,8 +3519,8 @@ void Clear(void)
     for (i = 0; MyVideoStream->ClearBuffers && i < 20; ++i) {
 	usleep(1 * 1000);
     }
-    Debug(3, "[softhddev]%s: %dms buffers %d\n", __FUNCTION__, i,
-	VideoGetBuffers(MyVideoStream));
+    Debug(3, "[softhddev]%s: %dms buffers %d %dms\n", __FUNCTION__, i,
+	VideoGetBuffers(MyVideoStream), VideoGetBuffersTime(MyVideoStream));
 }
 
 /**
@@ -3269,7 +3709,7 @@ int Poll(int timeout)
 	// soft limit + hard limit
 	full = (used > AUDIO_MIN_BUFFER_FREE && filled > 3)
 	    || AudioFreeBytes() < AUDIO_MIN_BUFFER_FREE
-	    || filled >= VIDEO_PACKET_MAX - 10;
+	    || VideoBuffersFull(MyVideoStream);
 
 	if (!full || !timeout) {
 	    return !full;
@@ -3292,6 +3732,8 @@ int Poll(int timeout)
 int Flush(int timeout)
 {
     if (atomic_read(&MyVideoStream->PacketsFilled)) {
+	Debug(4, "[softhddev]%s: %dms buffered\n", __FUNCTION__,
+	    VideoGetBuffersTime(MyVideoStream));
 	if (timeout) {			// let display thread work
 	    usleep(timeout * 1000);
 	}
@@ -3359,6 +3801,32 @@ void OsdDrawARGB(int xi, int yi, int height, int width, int pitch,
     VideoOsdDrawARGB(xi, yi, height, width, pitch, argb, x, y);
 }
 
+/**
+**	Finish OSD update.
+**
+**	Areas drawn by OsdDrawARGB are uploaded in one batch.
+*/
+void OsdFlush(void)
+{
+    VideoOsdFlush();
+}
+
+/**
+**	Submit OSD areas.
+**
+**	The areas are drawn by the video thread, which releases their
+**	buffers afterwards.
+**
+**	@param areas	osd areas with their buffers
+**	@param n	number of areas
+*/
+void OsdSubmit(const VideoOsdArea * areas, int n)
+{
+    // wakeup display for showing remote learning dialog
+    VideoDisplayWakeup();
+    VideoOsdSubmit(areas, n);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -3700,6 +4168,7 @@ int Start(void)
 	StartXServer();
     }
     CodecInit();
+    StartCodeInit();
 
     pthread_mutex_init(&MyVideoStream->DecoderLockMutex, NULL);
 #ifdef USE_PIP
@@ -3724,8 +4193,7 @@ int Start(void)
 	SkipAudio = 1;
     }
 #ifdef USE_TS
-    PesInit(&PesDemuxer[TS_PES_VIDEO]);
-    PesInit(&PesDemuxer[TS_PES_AUDIO]);
+    TsInit();
 #endif
     Info(_("[softhddev] ready%s\n"),
 	ConfigStartSuspended ? ConfigStartSuspended ==
@@ -3906,6 +4374,23 @@ void GetStats(int *missed, int *duped, int *dropped, int *counter, int *dec)
     }
 }
 
+/**
+**	Get decoder frame pool statistics.
+**
+**	@param[out] hits	frame buffers reused
+**	@param[out] misses	frame buffers allocated
+*/
+void GetPoolStats(int *hits, int *misses)
+{
+    *hits = 0;
+    *misses = 0;
+    pthread_mutex_lock(&MyVideoStream->DecoderLockMutex);
+    if (MyVideoStream->Decoder) {
+	CodecVideoGetPoolStats(MyVideoStream->Decoder, hits, misses);
+    }
+    pthread_mutex_unlock(&MyVideoStream->DecoderLockMutex);
+}
+
 /**
 **	Scale the currently shown video.
 **
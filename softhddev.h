@@ -36,6 +36,12 @@ extern "C"
     /// C plugin draw osd pixmap
     extern void OsdDrawARGB(int, int, int, int, int, const uint8_t *, int,
 	int);
+    /// C plugin finish osd update
+    extern void OsdFlush(void);
+    /// osd area of a buffer, see video.h
+    struct _video_osd_area_;
+    /// C plugin submit osd areas
+    extern void OsdSubmit(const struct _video_osd_area_ *, int);
 
     /// C plugin play audio packet
     extern int PlayAudio(const uint8_t *, int, uint8_t);
@@ -46,6 +52,26 @@ extern "C"
     /// C plugin reset channel id (restarts audio)
     extern void ResetChannelId(void);
 
+    /// transport stream demuxer typedef
+    typedef struct _ts_demux_ TsDemux;
+    /// transport stream payload handler (opaque, data, size, is_start)
+    typedef void (*TsPayloadHandler) (void *, const uint8_t *, int, int);
+    /// transport stream lost payload handler (opaque)
+    typedef void (*TsFlushHandler) (void *);
+    /// handler pid for all other packet ids
+#define TS_PID_ANY -1
+    /// C plugin new transport stream demuxer
+    extern TsDemux *TsDemuxNew(void);
+    /// C plugin delete transport stream demuxer
+    extern void TsDemuxDel(TsDemux *);
+    /// C plugin add transport stream pid handler
+    extern int TsDemuxAddPid(TsDemux *, int, TsPayloadHandler,
+	TsFlushHandler, void *);
+    /// C plugin reset transport stream continuity
+    extern void TsDemuxReset(TsDemux *);
+    /// C plugin demux transport stream packets
+    extern int TsDemuxPackets(TsDemux *, const uint8_t *, int);
+
     /// C plugin play video packet
     extern int PlayVideo(const uint8_t *, int);
     /// C plugin play TS video packet
@@ -99,6 +125,8 @@ extern "C"
 
     /// Get decoder statistics
     extern void GetStats(int *, int *, int *, int *, int *);
+    /// Get decoder frame pool statistics
+    extern void GetPoolStats(int *, int *);
     /// C plugin scale video
     extern void ScaleVideo(int, int, int, int);
 
@@ -28,6 +28,7 @@
 //#include <vdr/osd.h>
 #include <vdr/dvbspu.h>
 #include <vdr/shutdown.h>
+#include <vdr/status.h>
 
 #ifdef HAVE_CONFIG
 #include "config.h"
@@ -54,6 +55,7 @@ extern "C"
 #include "video.h"
 #include "codec.h"
 #include "misc.h"
+#include "yuvconv.h"
 }
 
 #if APIVERSNUM >= 20301
@@ -163,6 +165,8 @@ static char ConfigAudioCompression;	///< config use volume compression
 static int ConfigAudioMaxCompression;	///< config max volume compression
 static int ConfigAudioStereoDescent;	///< config reduce stereo loudness
 int ConfigAudioBufferTime;		///< config size ms of audio buffer
+int ConfigVideoBufferSize;		///< config size MiB of video buffer
+int ConfigVideoBufferTime;		///< config size ms of video buffer
 int DisableOglOsd;			///< flag to disable openGL osd
 static int ConfigAudioAutoAES;		///< config automatic AES handling
 
@@ -369,6 +373,25 @@ extern "C" void FeedKeyPress(const char *keymap, const char *key, int repeat,
 //	OSD
 //////////////////////////////////////////////////////////////////////////////
 
+/**
+**	Rendered OSD pixmap, submitted to the video thread.
+*/
+class cSoftOsdPixmap:public cListObject
+{
+  public:
+    cPixmapMemory *Pixmap;		///< rendered pixmap
+    volatile char Released;		///< video thread is done with pixmap
+
+    cSoftOsdPixmap(cPixmapMemory * pixmap) {
+	Pixmap = pixmap;
+	Released = 0;
+    }
+    /// video osd buffer release callback
+    static void Release(void *opaque) {
+	((cSoftOsdPixmap *) opaque)->Released = 1;
+    }
+};
+
 /**
 **	Soft device plugin OSD class.
 */
@@ -376,6 +399,10 @@ class cSoftOsd:public cOsd
 {
   private:
     cSize maxPixmapSize;
+    uint32_t *argbBuffer;		///< bitmap to ARGB conversion buffer
+    int argbBufferSize;			///< pixels in conversion buffer
+    cList < cSoftOsdPixmap > submitted;	///< pixmaps submitted for drawing
+    void DestroySubmitted(bool);	///< destroy released pixmaps
   public:
     static volatile char Dirty;		///< flag force redraw everything
     int OsdLevel;			///< current osd level FIXME: remove
@@ -446,6 +473,8 @@ cSoftOsd::cSoftOsd(int left, int top, uint level)
     size = VideoMaxPixmapSize();
     maxPixmapSize.Set(size, size);
     UseOpenGl = 0;
+    argbBuffer = NULL;
+    argbBufferSize = 0;
 }
 
 /**
@@ -461,6 +490,9 @@ cSoftOsd::~cSoftOsd(void)
 
     SetActive(false);
     // done by SetActive: OsdClose();
+    // OsdClose has released all submitted pixmaps
+    DestroySubmitted(true);
+    free(argbBuffer);
 
 #ifdef USE_YAEPG
     // support yaepghd, video window
@@ -501,6 +533,29 @@ eOsdError cSoftOsd::SetAreas(const tArea * areas, int n)
     return cOsd::SetAreas(areas, n);
 }
 
+/**
+**	Destroy the submitted pixmaps, which the video thread has released.
+**
+**	@param all	destroy all submitted pixmaps
+*/
+void cSoftOsd::DestroySubmitted(bool all)
+{
+    cSoftOsdPixmap *sp;
+    cSoftOsdPixmap *next;
+
+    for (sp = submitted.First(); sp; sp = next) {
+	next = submitted.Next(sp);
+	if (all || sp->Released) {
+#if APIVERSNUM >= 20110
+	    DestroyPixmap(sp->Pixmap);
+#else
+	    delete sp->Pixmap;
+#endif
+	    submitted.Del(sp);
+	}
+    }
+}
+
 /**
 **	Actually commits all data to the OSD hardware.
 */
@@ -546,11 +601,10 @@ void cSoftOsd::Flush(void)
 #endif
 	// draw all bitmaps
 	for (i = 0; (bitmap = GetBitmap(i)); ++i) {
-	    uint8_t *argb;
+	    uint32_t palette[256];
 	    int xs;
 	    int ys;
-	    int x;
-	    int y;
+	    int j;
 	    int w;
 	    int h;
 	    int x1;
@@ -621,30 +675,43 @@ void cSoftOsd::Flush(void)
 		abort();
 	    }
 #endif
-	    argb = (uint8_t *) malloc(w * h * sizeof(uint32_t));
-	    for (y = y1; y <= y2; ++y) {
-		for (x = x1; x <= x2; ++x) {
-		    ((uint32_t *) argb)[x - x1 + (y - y1) * w] =
-			bitmap->GetColor(x, y);
+	    if (w * h > argbBufferSize) {
+		free(argbBuffer);
+		argbBufferSize = w * h;
+		argbBuffer = (uint32_t *) malloc(argbBufferSize *
+		    sizeof(uint32_t));
+		if (!argbBuffer) {
+		    argbBufferSize = 0;
+		    Error(tr("[softhddev]: out of memory\n"));
+		    break;
 		}
 	    }
+	    // same as GetColor(), indices past the palette are black
+	    for (j = 0; j < 256; ++j) {
+		palette[j] = bitmap->Color(j);
+	    }
+	    YuvConvPalette(argbBuffer, w * sizeof(uint32_t),
+		bitmap->Data(x1, y1), bitmap->Width(), palette, w, h);
 #ifdef OSD_DEBUG
 	    Debug(3, "[softhddev]%s: draw %dx%d%+d%+d bm\n", __FUNCTION__, w, h,
 		xs + x1, ys + y1);
 #endif
-	    OsdDrawARGB(0, 0, w, h, w * sizeof(uint32_t), argb, xs + x1,
-		ys + y1);
+	    OsdDrawARGB(0, 0, w, h, w * sizeof(uint32_t),
+		(const uint8_t *)argbBuffer, xs + x1, ys + y1);
 
 	    bitmap->Clean();
-	    // FIXME: reuse argb
-	    free(argb);
 	}
+	OsdFlush();
 	Dirty = 0;
 	return;
     }
 
+    DestroySubmitted(false);
+
     LOCK_PIXMAPS;
     while ((pm = (dynamic_cast < cPixmapMemory * >(RenderPixmaps())))) {
+	cSoftOsdPixmap *sp;
+	VideoOsdArea area;
 	int xp;
 	int yp;
 	int stride;
@@ -714,13 +781,27 @@ void cSoftOsd::Flush(void)
 	Debug(3, "[softhddev]%s: draw %dx%d%+d%+d*%d -> %+d%+d %p\n",
 	    __FUNCTION__, w, h, xp, yp, stride, x, y, pm->Data());
 #endif
-	OsdDrawARGB(xp, yp, w, h, stride, pm->Data(), x, y);
-
+	// pixmap is kept until the video thread has drawn it
+	sp = new cSoftOsdPixmap(pm);
+	if (!(area.Buffer = VideoOsdBufferNew(pm->Data(), stride,
+		    cSoftOsdPixmap::Release, sp))) {
+	    delete sp;
 #if APIVERSNUM >= 20110
-	DestroyPixmap(pm);
+	    DestroyPixmap(pm);
 #else
-	delete pm;
+	    delete pm;
 #endif
+	    continue;
+	}
+	submitted.Add(sp);
+	area.Xi = xp;
+	area.Yi = yp;
+	area.Width = w;
+	area.Height = h;
+	area.X = x;
+	area.Y = y;
+	OsdSubmit(&area, 1);
+	VideoOsdBufferUnref(area.Buffer);
     }
     Dirty = 0;
 }
@@ -1042,6 +1123,9 @@ class cMenuSetupSoft:public cMenuSetupPage
     int AudioBufferTime;
     int AudioAutoAES;
 
+    int VideoBufferSize;
+    int VideoBufferTime;
+
 #ifdef USE_PIP
     int Pip;
     int PipX;
@@ -1247,6 +1331,10 @@ void cMenuSetupSoft::Create(void)
 		&BlackPicture, trVDR("no"), trVDR("yes")));
 	Add(new cMenuEditBoolItem(tr("Clear decoder on channel switch"),
 		&ClearOnSwitch, trVDR("no"), trVDR("yes")));
+	Add(new cMenuEditIntItem(tr("Video buffer size (MiB)"),
+		&VideoBufferSize, 0, 1024));
+	Add(new cMenuEditIntItem(tr("Video buffer time (ms)"),
+		&VideoBufferTime, 0, 10000));
 
 	if (brightness_active)
 		Add(new cMenuEditIntItem(*cString::sprintf(tr("Brightness (%d..[%d]..%d)"),
@@ -1608,6 +1696,9 @@ cMenuSetupSoft::cMenuSetupSoft(void)
     AudioBufferTime = ConfigAudioBufferTime;
     AudioAutoAES = ConfigAudioAutoAES;
 
+    VideoBufferSize = ConfigVideoBufferSize;
+    VideoBufferTime = ConfigVideoBufferTime;
+
 #ifdef USE_PIP
     //
     //	PIP
@@ -1840,6 +1931,9 @@ void cMenuSetupSoft::Store(void)
     SetupStore("AudioAutoAES", ConfigAudioAutoAES = AudioAutoAES);
     AudioSetAutoAES(ConfigAudioAutoAES);
 
+    SetupStore("VideoBufferSize", ConfigVideoBufferSize = VideoBufferSize);
+    SetupStore("VideoBufferTime", ConfigVideoBufferTime = VideoBufferTime);
+
 #ifdef USE_PIP
     SetupStore("pip.X", ConfigPipX = PipX);
     SetupStore("pip.Y", ConfigPipY = PipY);
@@ -1982,6 +2076,96 @@ static int PipAltPosition;		///< flag alternative position
 
 #include <vdr/receiver.h>
 
+static uint8_t *PipPesBuf;		///< PIP pes packet buffer
+static int PipPesSize;			///< PIP pes buffer size
+static int PipPesIndex;			///< PIP pes buffer index
+
+///
+///	Parse packetized elementary stream.
+///
+///	@param data	payload data of transport stream
+///	@param size	number of payload data bytes
+///	@param is_start flag, start of pes packet
+///
+static void PipPesParse(const uint8_t * data, int size, int is_start)
+{
+    if (!data) {
+	if (PipPesBuf) {
+	    free(PipPesBuf);
+	    PipPesBuf = NULL;
+	}
+	return;
+    }
+    // FIXME: quick&dirty
+
+    if (!PipPesBuf) {
+	PipPesSize = 500 * 1024 * 1024;
+	PipPesBuf = (uint8_t *) malloc(PipPesSize);
+	if (!PipPesBuf) {		// out of memory, should never happen
+	    return;
+	}
+	PipPesIndex = 0;
+    }
+    if (is_start) {			// start of pes packet
+	if (PipPesIndex) {
+	    if (0) {
+		fprintf(stderr, "pip: PES packet %8d %02x%02x\n", PipPesIndex,
+		    PipPesBuf[2], PipPesBuf[3]);
+	    }
+	    if (PipPesBuf[0] || PipPesBuf[1] || PipPesBuf[2] != 0x01) {
+		// FIXME: first should always fail
+		Error(tr("[softhddev]pip: invalid PES packet %d\n"),
+		    PipPesIndex);
+	    } else {
+		PipPlayVideo(PipPesBuf, PipPesIndex);
+		// FIXME: buffer full: pes packet is dropped
+	    }
+	    PipPesIndex = 0;
+	}
+    }
+
+    if (PipPesIndex + size > PipPesSize) {
+	Error(tr("[softhddev]pip: pes buffer too small\n"));
+	PipPesSize *= 2;
+	if (PipPesIndex + size > PipPesSize) {
+	    PipPesSize = (PipPesIndex + size) * 2;
+	}
+	void *res = (uint8_t *) realloc(PipPesBuf, PipPesSize);
+	if (!res) {			// out of memory, should never happen
+	    return;
+	} else PipPesBuf = (uint8_t *)res;
+    }
+    memcpy(PipPesBuf + PipPesIndex, data, size);
+    PipPesIndex += size;
+}
+
+///
+///	Transport stream payload handler of PIP.
+///
+///	@param opaque	unused
+///	@param data	payload data of transport stream
+///	@param size	number of payload data bytes
+///	@param is_start flag, start of pes packet
+///
+static void PipTsPayload(void *opaque, const uint8_t * data, int size,
+    int is_start)
+{
+    // without a start the pes packet is already dropped
+    if (is_start || PipPesIndex) {
+	PipPesParse(data, size, is_start);
+    }
+}
+
+///
+///	Drop unfinished PIP pes packet, after ts packets are lost.
+///
+///	@param opaque	unused
+///
+static void PipTsFlush(void *opaque)
+{
+    PipPesIndex = 0;
+}
+
 /**
 **	Receiver class for PIP mode.
 */
@@ -1994,6 +2178,7 @@ class cSoftReceiver:public cReceiver
 #else
     virtual void Receive(uchar *, int);
 #endif
+    TsDemux *Demux;			///< transport stream demuxer
   public:
      cSoftReceiver(const cChannel *);	///< receiver constructor
      virtual ~ cSoftReceiver();		///< receiver destructor
@@ -2010,6 +2195,9 @@ cSoftReceiver::cSoftReceiver(const cChannel * channel):cReceiver(NULL,
     // cReceiver::channelID not setup, this can cause trouble
     // we want video only
     AddPid(channel->Vpid());
+    if ((Demux = TsDemuxNew())) {
+	TsDemuxAddPid(Demux, channel->Vpid(), PipTsPayload, PipTsFlush, NULL);
+    }
 }
 
 /**
@@ -2018,6 +2206,9 @@ cSoftReceiver::cSoftReceiver(const cChannel * channel):cReceiver(NULL,
 cSoftReceiver::~cSoftReceiver()
 {
     Detach();
+    if (Demux) {
+	TsDemuxDel(Demux);
+    }
 }
 
 /**
@@ -2060,79 +2251,11 @@ void cSoftReceiver::Activate(bool on)
     }
 }
 
-///
-///	Parse packetized elementary stream.
-///
-///	@param data	payload data of transport stream
-///	@param size	number of payload data bytes
-///	@param is_start flag, start of pes packet
-///
-static void PipPesParse(const uint8_t * data, int size, int is_start)
-{
-    static uint8_t *pes_buf;
-    static int pes_size;
-    static int pes_index;
-
-    if (!data) {
-	if (pes_buf) {
-	    free(pes_buf);
-	    pes_buf = NULL;
-	}
-	return;
-    }
-    // FIXME: quick&dirty
-
-    if (!pes_buf) {
-	pes_size = 500 * 1024 * 1024;
-	pes_buf = (uint8_t *) malloc(pes_size);
-	if (!pes_buf) {			// out of memory, should never happen
-	    return;
-	}
-	pes_index = 0;
-    }
-    if (is_start) {			// start of pes packet
-	if (pes_index) {
-	    if (0) {
-		fprintf(stderr, "pip: PES packet %8d %02x%02x\n", pes_index,
-		    pes_buf[2], pes_buf[3]);
-	    }
-	    if (pes_buf[0] || pes_buf[1] || pes_buf[2] != 0x01) {
-		// FIXME: first should always fail
-		Error(tr("[softhddev]pip: invalid PES packet %d\n"),
-		    pes_index);
-	    } else {
-		PipPlayVideo(pes_buf, pes_index);
-		// FIXME: buffer full: pes packet is dropped
-	    }
-	    pes_index = 0;
-	}
-    }
-
-    if (pes_index + size > pes_size) {
-	Error(tr("[softhddev]pip: pes buffer too small\n"));
-	pes_size *= 2;
-	if (pes_index + size > pes_size) {
-	    pes_size = (pes_index + size) * 2;
-	}
-	void *res = (uint8_t *) realloc(pes_buf, pes_size);
-	if (!res) {			// out of memory, should never happen
-	    return;
-	} else pes_buf = (uint8_t *)res;
-    }
-    memcpy(pes_buf + pes_index, data, size);
-    pes_index += size;
-}
-
-    /// Transport stream packet size
-#define TS_PACKET_SIZE	188
-    /// Transport stream packet sync byte
-#define TS_PACKET_SYNC	0x47
-
 /**
 **	Receive TS packet from device.
 **
-**	@param data	ts packet
-**	@param size	size (#TS_PACKET_SIZE=188) of tes packet
+**	@param data	ts packets
+**	@param size	size (n * 188) of ts packets
 */
 #if APIVERSNUM >= 20301
 void cSoftReceiver::Receive(const uchar * data, int size)
@@ -2140,53 +2263,8 @@ void cSoftReceiver::Receive(const uchar * data, int size)
 void cSoftReceiver::Receive(uchar * data, int size)
 #endif
 {
-    const uint8_t *p;
-
-    p = data;
-    while (size >= TS_PACKET_SIZE) {
-	int payload;
-
-	if (p[0] != TS_PACKET_SYNC) {
-	    Error(tr("[softhddev]tsdemux: transport stream out of sync\n"));
-	    // FIXME: kill all buffers
-	    return;
-	}
-	if (p[1] & 0x80) {		// error indicatord
-	    Debug(3, "[softhddev]tsdemux: transport error\n");
-	    // FIXME: kill all buffers
-	    goto next_packet;
-	}
-	if (0) {
-	    int pid;
-
-	    pid = (p[1] & 0x1F) << 8 | p[2];
-	    fprintf(stderr, "tsdemux: PID: %#04x%s%s\n", pid,
-		p[1] & 0x40 ? " start" : "", p[3] & 0x10 ? " payload" : "");
-	}
-	// skip adaptation field
-	switch (p[3] & 0x30) {		// adaption field
-	    case 0x00:			// reserved
-	    case 0x20:			// adaptation field only
-	    default:
-		goto next_packet;
-	    case 0x10:			// only payload
-		payload = 4;
-		break;
-	    case 0x30:			// skip adapation field
-		payload = 5 + p[4];
-		// illegal length, ignore packet
-		if (payload >= TS_PACKET_SIZE) {
-		    Debug(3, "[softhddev]tsdemux: illegal adaption field length\n");
-		    goto next_packet;
-		}
-		break;
-	}
-
-	PipPesParse(p + payload, TS_PACKET_SIZE - payload, p[1] & 0x40);
-
-      next_packet:
-	p += TS_PACKET_SIZE;
-	size -= TS_PACKET_SIZE;
+    if (Demux) {
+	TsDemuxPackets(Demux, data, size);
     }
 }
 
@@ -2408,6 +2486,10 @@ void cSoftHdMenu::Create(void)
     int dropped;
     int counter;
     int dec;
+    int hits;
+    int misses;
+    int wakeups;
+    int pixels;
     const char * HWAccelName[] = {
      "SOFTWARE",
      "AUTO",
@@ -2462,6 +2544,15 @@ void cSoftHdMenu::Create(void)
 	cOsdItem(cString::sprintf(tr
 		(" Frames missed(%d) duped(%d) dropped(%d) total(%d)"), missed,
 		duped, dropped, counter), osUnknown, false));
+    GetPoolStats(&hits, &misses);
+    Add(new cOsdItem(cString::sprintf(tr(" Frame pool hits(%d) misses(%d)"),
+		hits, misses), osUnknown, false));
+    AudioGetStats(&wakeups);
+    Add(new cOsdItem(cString::sprintf(tr(" Audio thread wakeups(%d/s)"),
+		wakeups), osUnknown, false));
+    VideoOsdGetStats(&pixels);
+    Add(new cOsdItem(cString::sprintf(tr(" OSD upload(%d pixel/s)"),
+		pixels), osUnknown, false));
 
     SetCurrent(Get(current));		// restore selected menu entry
     Display();				// display build menu
@@ -3379,6 +3470,42 @@ extern "C" uint8_t * CreateJpeg(uint8_t * image, int *size, int quality,
 	quality);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//	cStatus
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Status monitor class, follows the live channel for auto-crop.
+*/
+class cSoftStatus:public cStatus
+{
+  protected:
+    virtual void ChannelSwitch(const cDevice *, int, bool);
+};
+
+/**
+**	Live channel switched, use the remembered auto-crop of the channel.
+**
+**	@param device		device switched
+**	@param channel_nr	new channel number, 0 switch starts
+**	@param live_view	switch of the live channel
+*/
+void cSoftStatus::ChannelSwitch(__attribute__ ((unused)) const cDevice *
+    device, int channel_nr, bool live_view)
+{
+    const cChannel *channel;
+
+    if (!channel_nr || !live_view) {
+	return;
+    }
+    LOCK_CHANNELS_READ;
+    if ((channel = Channels MURKS GetByNumber(channel_nr))) {
+	::VideoAutoCropChannel(channel->GetChannelID().ToString());
+    }
+}
+
+static cSoftStatus *SoftStatus;		///< live channel status monitor
+
 //////////////////////////////////////////////////////////////////////////////
 //	cPlugin
 //////////////////////////////////////////////////////////////////////////////
@@ -3505,6 +3632,10 @@ bool cPluginSoftHdDevice::Start(void)
 
     csoft = new cSoftRemote;
 
+    ::VideoAutoCropLoad(AddDirectory(ConfigDirectory(Name()),
+	    "autocrop.conf"));
+    SoftStatus = new cSoftStatus;
+
     switch (::Start()) {
 	case 1:
 	    //cControl::Launch(new cSoftHdControl);
@@ -3532,6 +3663,10 @@ void cPluginSoftHdDevice::Stop(void)
     //Debug(3, "[softhddev]%s:\n", __FUNCTION__);
     if (ConfigVideoGeometry && strlen(ConfigVideoGeometry))
         SetupStore("VideoGeometry", VideoGetGeometry());
+    delete SoftStatus;
+    SoftStatus = NULL;
+    ::VideoAutoCropSave(AddDirectory(ConfigDirectory(Name()),
+	    "autocrop.conf"));
     ::Stop();
     delete csoft;
     csoft = NULL;
@@ -3864,6 +3999,14 @@ bool cPluginSoftHdDevice::SetupParse(const char *name, const char *value)
 	AudioSetBufferTime(ConfigAudioBufferTime);
 	return true;
     }
+    if (!strcasecmp(name, "VideoBufferSize")) {
+	ConfigVideoBufferSize = atoi(value);
+	return true;
+    }
+    if (!strcasecmp(name, "VideoBufferTime")) {
+	ConfigVideoBufferTime = atoi(value);
+	return true;
+    }
     if (!strcasecmp(name, "AudioAutoAES")) {
 	ConfigAudioAutoAES = atoi(value);
 	AudioSetAutoAES(ConfigAudioAutoAES);
@@ -4031,6 +4174,32 @@ bool cPluginSoftHdDevice::Service(const char *id, void *data)
 	return true;
     }
 
+    if (strcmp(id, PREVIEW_SERVICE) == 0) {
+	SoftHDDevice_PreviewService_v1_0_t *r;
+
+	if (!data) {
+	    return true;
+	}
+
+	if (SuspendMode != NOT_SUSPENDED) {
+	    return false;
+	}
+
+	r = (SoftHDDevice_PreviewService_v1_0_t *) data;
+	if (r->width < 16 || r->width > 1920 || r->height < 16
+	    || r->height > 1080 || r->interval < 0) {
+	    return false;
+	}
+	r->img =
+	    VideoGetPreview(&r->size, &r->width, &r->height, r->interval,
+	    &r->serial);
+	if (!r->img) {
+	    return false;
+	}
+
+	return true;
+    }
+
     return false;
 }
 
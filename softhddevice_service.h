@@ -25,6 +25,7 @@
 #define ATMO_GRAB_SERVICE	"SoftHDDevice-AtmoGrabService-v1.0"
 #define ATMO1_GRAB_SERVICE	"SoftHDDevice-AtmoGrabService-v1.1"
 #define OSD_3DMODE_SERVICE	"SoftHDDevice-Osd3DModeService-v1.0"
+#define PREVIEW_SERVICE	"SoftHDDevice-PreviewService-v1.0"
 
 enum
 { GRAB_IMG_RGBA_FORMAT_B8G8R8A8 };
@@ -63,3 +64,15 @@ typedef struct
 
     void *img;
 } SoftHDDevice_AtmoGrabService_v1_1_t;
+
+typedef struct
+{
+    // request data
+    int width;				///< preview width 16 .. 1920
+    int height;				///< preview height 16 .. 1080
+    int interval;			///< preview interval in ms
+    // reply data
+    int serial;				///< changes with every new preview
+    int size;				///< size of image
+    void *img;				///< B8G8R8A8 image, free() it
+} SoftHDDevice_PreviewService_v1_0_t;
@@ -0,0 +1,649 @@
+///
+///	@file startcode.c	@brief Start code scanner module
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup StartCode The start code scanner module.
+///
+///	Finds 0x00 0x00 0x01 video start code prefixes and audio sync words
+///	(Mpeg 0xFFE, ADTS 0xFFF, AC-3 0x0B77, LATM 0x56E, DTS 0x7FFE).
+///	The audio scanner only finds candidates, the codec checks must
+///	still validate the frame header.
+///
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "startcode.h"
+
+///
+///	Start code scanner kernel.
+///
+typedef struct _start_code_kernel_
+{
+    const char *Name;			///< kernel name
+
+    int (*const Supported) (void);	///< cpu supports kernel
+    int (*const Find) (const uint8_t *, int);	///< find start code
+    int (*const SyncFind) (const uint8_t *, int);	///< find sync word
+} StartCodeKernel;
+
+//----------------------------------------------------------------------------
+//	C reference kernels
+//----------------------------------------------------------------------------
+
+///
+///	C kernel always supported.
+///
+static int StartCodeSupportedC(void)
+{
+    return 1;
+}
+
+///
+///	Find start code prefix 0x00 0x00 0x01.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+///	@returns offset of the first prefix completely in buffer, -1 if none.
+///
+static int StartCodeFindC(const uint8_t * data, int size)
+{
+    int i;
+
+    i = 0;
+    while (i + 2 < size) {
+	if (data[i + 2] > 0x01) {	// no prefix can cover this byte
+	    i += 3;
+	} else if (!data[i + 2]) {
+	    ++i;
+	} else {
+	    if (!data[i] && !data[i + 1]) {
+		return i;
+	    }
+	    i += 3;
+	}
+    }
+    return -1;
+}
+
+///
+///	Is audio sync word candidate.
+///
+///	@param p	two bytes to check
+///
+static inline int StartCodeIsSync(const uint8_t * p)
+{
+    switch (p[0]) {
+	case 0xFF:			// Mpeg 0xFFE, ADTS 0xFFF
+	case 0x56:			// LATM 0x56E
+	    return (p[1] & 0xE0) == 0xE0;
+	case 0x0B:			// AC-3 0x0B77
+	    return p[1] == 0x77;
+	case 0x7F:			// DTS 0x7FFE8001
+	    return p[1] == 0xFE;
+    }
+    return 0;
+}
+
+///
+///	Find audio sync word candidate.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+///	@returns offset of the first candidate completely in buffer, -1 if
+///	none.
+///
+static int StartCodeSyncFindC(const uint8_t * data, int size)
+{
+    int i;
+
+    for (i = 0; i + 1 < size; ++i) {
+	if (StartCodeIsSync(data + i)) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+    /// C reference kernels
+static const StartCodeKernel StartCodeC = {
+    .Name = "C",
+    .Supported = StartCodeSupportedC,
+    .Find = StartCodeFindC,
+    .SyncFind = StartCodeSyncFindC,
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//----------------------------------------------------------------------------
+//	SSE2 kernels
+//----------------------------------------------------------------------------
+
+///
+///	Check if cpu supports SSE2.
+///
+static int StartCodeSupportedSse2(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+///
+///	Find start code prefix 0x00 0x00 0x01, 16 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+__attribute__ ((target("sse2")))
+static int StartCodeFindSse2(const uint8_t * data, int size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(0x01);
+    int i;
+    int r;
+
+    for (i = 0; i + 16 + 2 <= size; i += 16) {
+	__m128i a;
+	__m128i b;
+	__m128i c;
+	unsigned m;
+
+	c = _mm_loadu_si128((const __m128i *)(data + i + 2));
+	m = _mm_movemask_epi8(_mm_cmpeq_epi8(c, one));
+	if (!m) {			// fast path: no 0x01
+	    continue;
+	}
+	a = _mm_loadu_si128((const __m128i *)(data + i));
+	b = _mm_loadu_si128((const __m128i *)(data + i + 1));
+	m &= _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, zero),
+		_mm_cmpeq_epi8(b, zero)));
+	if (m) {
+	    return i + __builtin_ctz(m);
+	}
+    }
+    r = StartCodeFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+///
+///	Find audio sync word candidate, 16 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+__attribute__ ((target("sse2")))
+static int StartCodeSyncFindSse2(const uint8_t * data, int size)
+{
+    const __m128i e0 = _mm_set1_epi8((char)0xE0);
+    int i;
+    int r;
+
+    for (i = 0; i + 16 + 1 <= size; i += 16) {
+	__m128i a;
+	__m128i b;
+	__m128i t;
+	unsigned m;
+
+	a = _mm_loadu_si128((const __m128i *)(data + i));
+	b = _mm_loadu_si128((const __m128i *)(data + i + 1));
+	// 0xFF or 0x56 followed by 0xE0 mask
+	t = _mm_or_si128(_mm_cmpeq_epi8(a, _mm_set1_epi8((char)0xFF)),
+	    _mm_cmpeq_epi8(a, _mm_set1_epi8(0x56)));
+	t = _mm_and_si128(t, _mm_cmpeq_epi8(_mm_and_si128(b, e0), e0));
+	// 0x0B77
+	t = _mm_or_si128(t, _mm_and_si128(_mm_cmpeq_epi8(a,
+		    _mm_set1_epi8(0x0B)), _mm_cmpeq_epi8(b,
+		    _mm_set1_epi8(0x77))));
+	// 0x7FFE
+	t = _mm_or_si128(t, _mm_and_si128(_mm_cmpeq_epi8(a,
+		    _mm_set1_epi8(0x7F)), _mm_cmpeq_epi8(b,
+		    _mm_set1_epi8((char)0xFE))));
+	if ((m = _mm_movemask_epi8(t))) {
+	    return i + __builtin_ctz(m);
+	}
+    }
+    r = StartCodeSyncFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+    /// SSE2 kernels
+static const StartCodeKernel StartCodeSse2 = {
+    .Name = "SSE2",
+    .Supported = StartCodeSupportedSse2,
+    .Find = StartCodeFindSse2,
+    .SyncFind = StartCodeSyncFindSse2,
+};
+
+//----------------------------------------------------------------------------
+//	AVX2 kernels
+//----------------------------------------------------------------------------
+
+///
+///	Check if cpu supports AVX2.
+///
+static int StartCodeSupportedAvx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+///
+///	Find start code prefix 0x00 0x00 0x01, 32 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+__attribute__ ((target("avx2")))
+static int StartCodeFindAvx2(const uint8_t * data, int size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(0x01);
+    int i;
+    int r;
+
+    for (i = 0; i + 32 + 2 <= size; i += 32) {
+	__m256i a;
+	__m256i b;
+	__m256i c;
+	unsigned m;
+
+	c = _mm256_loadu_si256((const __m256i *)(data + i + 2));
+	m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, one));
+	if (!m) {			// fast path: no 0x01
+	    continue;
+	}
+	a = _mm256_loadu_si256((const __m256i *)(data + i));
+	b = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+	m &= _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a,
+		    zero), _mm256_cmpeq_epi8(b, zero)));
+	if (m) {
+	    return i + __builtin_ctz(m);
+	}
+    }
+    r = StartCodeFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+///
+///	Find audio sync word candidate, 32 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+__attribute__ ((target("avx2")))
+static int StartCodeSyncFindAvx2(const uint8_t * data, int size)
+{
+    const __m256i e0 = _mm256_set1_epi8((char)0xE0);
+    int i;
+    int r;
+
+    for (i = 0; i + 32 + 1 <= size; i += 32) {
+	__m256i a;
+	__m256i b;
+	__m256i t;
+	unsigned m;
+
+	a = _mm256_loadu_si256((const __m256i *)(data + i));
+	b = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+	// 0xFF or 0x56 followed by 0xE0 mask
+	t = _mm256_or_si256(_mm256_cmpeq_epi8(a,
+		_mm256_set1_epi8((char)0xFF)), _mm256_cmpeq_epi8(a,
+		_mm256_set1_epi8(0x56)));
+	t = _mm256_and_si256(t, _mm256_cmpeq_epi8(_mm256_and_si256(b, e0),
+		e0));
+	// 0x0B77
+	t = _mm256_or_si256(t, _mm256_and_si256(_mm256_cmpeq_epi8(a,
+		    _mm256_set1_epi8(0x0B)), _mm256_cmpeq_epi8(b,
+		    _mm256_set1_epi8(0x77))));
+	// 0x7FFE
+	t = _mm256_or_si256(t, _mm256_and_si256(_mm256_cmpeq_epi8(a,
+		    _mm256_set1_epi8(0x7F)), _mm256_cmpeq_epi8(b,
+		    _mm256_set1_epi8((char)0xFE))));
+	if ((m = _mm256_movemask_epi8(t))) {
+	    return i + __builtin_ctz(m);
+	}
+    }
+    r = StartCodeSyncFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+    /// AVX2 kernels
+static const StartCodeKernel StartCodeAvx2 = {
+    .Name = "AVX2",
+    .Supported = StartCodeSupportedAvx2,
+    .Find = StartCodeFindAvx2,
+    .SyncFind = StartCodeSyncFindAvx2,
+};
+
+#endif
+
+#ifdef __ARM_NEON
+
+//----------------------------------------------------------------------------
+//	NEON kernels
+//----------------------------------------------------------------------------
+
+///
+///	NEON is selected at compile time.
+///
+static int StartCodeSupportedNeon(void)
+{
+    return 1;
+}
+
+///
+///	Bit mask of compare result, 4 bits each byte.
+///
+///	@param v	compare result
+///
+static inline uint64_t StartCodeMaskNeon(uint8x16_t v)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8
+		(v), 4)), 0);
+}
+
+///
+///	Find start code prefix 0x00 0x00 0x01, 16 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+static int StartCodeFindNeon(const uint8_t * data, int size)
+{
+    int i;
+    int r;
+
+    for (i = 0; i + 16 + 2 <= size; i += 16) {
+	uint8x16_t a;
+	uint8x16_t b;
+	uint8x16_t c;
+	uint64_t m;
+
+	c = vceqq_u8(vld1q_u8(data + i + 2), vdupq_n_u8(0x01));
+	if (!StartCodeMaskNeon(c)) {	// fast path: no 0x01
+	    continue;
+	}
+	a = vceqq_u8(vld1q_u8(data + i), vdupq_n_u8(0x00));
+	b = vceqq_u8(vld1q_u8(data + i + 1), vdupq_n_u8(0x00));
+	if ((m = StartCodeMaskNeon(vandq_u8(vandq_u8(a, b), c)))) {
+	    return i + __builtin_ctzll(m) / 4;
+	}
+    }
+    r = StartCodeFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+///
+///	Find audio sync word candidate, 16 bytes each step.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+static int StartCodeSyncFindNeon(const uint8_t * data, int size)
+{
+    int i;
+    int r;
+
+    for (i = 0; i + 16 + 1 <= size; i += 16) {
+	uint8x16_t a;
+	uint8x16_t b;
+	uint8x16_t t;
+	uint64_t m;
+
+	a = vld1q_u8(data + i);
+	b = vld1q_u8(data + i + 1);
+	// 0xFF or 0x56 followed by 0xE0 mask
+	t = vorrq_u8(vceqq_u8(a, vdupq_n_u8(0xFF)), vceqq_u8(a,
+		vdupq_n_u8(0x56)));
+	t = vandq_u8(t, vceqq_u8(vandq_u8(b, vdupq_n_u8(0xE0)),
+		vdupq_n_u8(0xE0)));
+	// 0x0B77
+	t = vorrq_u8(t, vandq_u8(vceqq_u8(a, vdupq_n_u8(0x0B)), vceqq_u8(b,
+		    vdupq_n_u8(0x77))));
+	// 0x7FFE
+	t = vorrq_u8(t, vandq_u8(vceqq_u8(a, vdupq_n_u8(0x7F)), vceqq_u8(b,
+		    vdupq_n_u8(0xFE))));
+	if ((m = StartCodeMaskNeon(t))) {
+	    return i + __builtin_ctzll(m) / 4;
+	}
+    }
+    r = StartCodeSyncFindC(data + i, size - i);
+    return r < 0 ? r : i + r;
+}
+
+    /// NEON kernels
+static const StartCodeKernel StartCodeNeon = {
+    .Name = "NEON",
+    .Supported = StartCodeSupportedNeon,
+    .Find = StartCodeFindNeon,
+    .SyncFind = StartCodeSyncFindNeon,
+};
+
+#endif
+
+    /// available kernels, best first
+static const StartCodeKernel *const StartCodeKernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    &StartCodeAvx2,
+    &StartCodeSse2,
+#endif
+#ifdef __ARM_NEON
+    &StartCodeNeon,
+#endif
+    &StartCodeC,
+};
+
+    /// selected kernels
+static const StartCodeKernel *StartCodeUsed = &StartCodeC;
+
+///
+///	Select fastest scanner supported by the cpu.
+///
+void StartCodeInit(void)
+{
+    unsigned u;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+    for (u = 0; u < sizeof(StartCodeKernels) / sizeof(*StartCodeKernels);
+	++u) {
+	if (StartCodeKernels[u]->Supported()) {
+	    StartCodeUsed = StartCodeKernels[u];
+	    break;
+	}
+    }
+}
+
+///
+///	Find start code prefix 0x00 0x00 0x01.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+///	@returns offset of the first prefix completely in buffer, -1 if none.
+///
+int StartCodeFind(const uint8_t * data, int size)
+{
+    return StartCodeUsed->Find(data, size);
+}
+
+///
+///	Find audio sync word candidate.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+///	@returns offset of the first two byte candidate completely in
+///	buffer, -1 if none.
+///
+int StartCodeSyncFind(const uint8_t * data, int size)
+{
+    return StartCodeUsed->SyncFind(data, size);
+}
+
+#ifdef STARTCODE_TEST
+
+//----------------------------------------------------------------------------
+//	Test
+//----------------------------------------------------------------------------
+
+#include <time.h>
+
+///
+///	Count all matches of a scanner.
+///
+///	@param find	scanner function
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+static int StartCodeCount(int (*find) (const uint8_t *, int),
+    const uint8_t * data, int size)
+{
+    int count;
+    int i;
+    int r;
+
+    count = 0;
+    for (i = 0; (r = find(data + i, size - i)) >= 0; i += r + 1) {
+	++count;
+    }
+    return count;
+}
+
+///
+///	Benchmark all supported kernels.
+///
+///	@param data	buffer to scan
+///	@param size	number of bytes in buffer
+///
+static void StartCodeBench(const uint8_t * data, int size)
+{
+    unsigned u;
+    int ref_codes;
+    int ref_syncs;
+
+    ref_codes = StartCodeCount(StartCodeFindC, data, size);
+    ref_syncs = StartCodeCount(StartCodeSyncFindC, data, size);
+    printf("%d bytes, %d start codes, %d sync words\n", size, ref_codes,
+	ref_syncs);
+
+    for (u = 0; u < sizeof(StartCodeKernels) / sizeof(*StartCodeKernels);
+	++u) {
+	const StartCodeKernel *kernel;
+	struct timespec t0;
+	struct timespec t1;
+	double codes;
+	double syncs;
+	int loops;
+	int i;
+
+	kernel = StartCodeKernels[u];
+	if (!kernel->Supported()) {
+	    continue;
+	}
+	if (StartCodeCount(kernel->Find, data, size) != ref_codes
+	    || StartCodeCount(kernel->SyncFind, data, size) != ref_syncs) {
+	    printf("%-5s: results differ from C\n", kernel->Name);
+	}
+	loops = 1 + (256 << 20) / size;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < loops; ++i) {
+	    StartCodeCount(kernel->Find, data, size);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	codes = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < loops; ++i) {
+	    StartCodeCount(kernel->SyncFind, data, size);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	syncs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+	printf("%-5s: start code %6.2f GB/s, sync word %6.2f GB/s\n",
+	    kernel->Name, (double)size * loops / codes / 1e9,
+	    (double)size * loops / syncs / 1e9);
+    }
+}
+
+///
+///	Main entry point.
+///
+///	Benchmarks the scanners with recorded TS dumps or random data.
+///
+///	@param argc	number of arguments
+///	@param argv	arguments vector
+///
+int main(int argc, char *const argv[])
+{
+    uint8_t *data;
+    int size;
+    int i;
+
+    if (argc < 2) {
+	size = 64 << 20;
+	if (!(data = malloc(size))) {
+	    return -1;
+	}
+	srandom(1);
+	for (i = 0; i < size; ++i) {
+	    data[i] = random();
+	}
+	printf("random data:\n");
+	StartCodeBench(data, size);
+	free(data);
+	return 0;
+    }
+    for (i = 1; i < argc; ++i) {
+	FILE *file;
+	long n;
+
+	if (!(file = fopen(argv[i], "rb"))) {
+	    perror(argv[i]);
+	    continue;
+	}
+	fseek(file, 0, SEEK_END);
+	n = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (n <= 0 || n > INT32_MAX || !(data = malloc(n))) {
+	    fclose(file);
+	    continue;
+	}
+	size = fread(data, 1, n, file);
+	fclose(file);
+	printf("%s:\n", argv[i]);
+	StartCodeBench(data, size);
+	free(data);
+    }
+    return 0;
+}
+
+#endif
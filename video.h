@@ -33,6 +33,24 @@ typedef struct _video_hw_decoder_ VideoHwDecoder;
     /// Video output stream typedef
 typedef struct __video_stream__ VideoStream;
 
+    /// Video OSD buffer typedef
+typedef struct _video_osd_buffer_ VideoOsdBuffer;
+
+    /// Video OSD buffer release callback (opaque)
+typedef void (*VideoOsdRelease) (void *);
+
+    /// Video OSD area of a buffer
+typedef struct _video_osd_area_
+{
+    VideoOsdBuffer *Buffer;		///< buffer with ARGB image
+    int Xi;				///< x-coordinate in buffer
+    int Yi;				///< y-coordinate in buffer
+    int Width;				///< width in pixel
+    int Height;				///< height in pixel
+    int X;				///< x-coordinate on screen
+    int Y;				///< y-coordinate on screen
+} VideoOsdArea;
+
     /// Video resolutions selector
 typedef enum _video_resolutions_
 {
@@ -236,6 +254,15 @@ extern void VideoSetAudioDelay(int);
     /// Set auto-crop parameters.
 extern void VideoSetAutoCrop(int, int, int);
 
+    /// Set live channel for auto-crop channel cache.
+extern void VideoAutoCropChannel(const char *);
+
+    /// Load auto-crop channel cache.
+extern void VideoAutoCropLoad(const char *);
+
+    /// Save auto-crop channel cache.
+extern void VideoAutoCropSave(const char *);
+
     /// Clear OSD.
 extern void VideoOsdClear(void);
 
@@ -243,6 +270,22 @@ extern void VideoOsdClear(void);
 extern void VideoOsdDrawARGB(int, int, int, int, int, const uint8_t *, int,
     int);
 
+    /// Upload OSD areas drawn since last flush.
+extern void VideoOsdFlush(void);
+
+    /// Create an OSD buffer for submitting areas.
+extern VideoOsdBuffer *VideoOsdBufferNew(const uint8_t *, int,
+    VideoOsdRelease, void *);
+
+    /// Drop a reference of an OSD buffer.
+extern void VideoOsdBufferUnref(VideoOsdBuffer *);
+
+    /// Submit OSD areas, drawn by the video thread.
+extern void VideoOsdSubmit(const VideoOsdArea *, int);
+
+    /// Get OSD statistics.
+extern void VideoOsdGetStats(int *);
+
     /// Activate displaying OSD
 void ActivateOsd(void);
 #ifdef USE_VDPAU
@@ -322,6 +365,12 @@ extern uint8_t *VideoGrab(int *, int *, int *, int);
     /// Grab screen raw.
 extern uint8_t *VideoGrabService(int *, int *, int *);
 
+    /// Grab screen as padded YCbCr 4:2:0 planes.
+extern uint8_t *VideoGrabYCbCr(int *, int *, int *);
+
+    /// Get latest preview of the preview tap.
+extern uint8_t *VideoGetPreview(int *, int *, int *, int, int *);
+
     /// Get decoder statistics.
 extern void VideoGetStats(VideoHwDecoder *, int *, int *, int *, int *, int *);
 
@@ -346,6 +395,9 @@ extern int VideoDecodeInput(VideoStream *);
     /// Get number of input buffers.
 extern int VideoGetBuffers(const VideoStream *);
 
+    /// Get presentation time of input buffers in ms.
+extern int VideoGetBuffersTime(const VideoStream *);
+
     /// Set DPMS switch
 extern void SetDPMS(int);
 
@@ -0,0 +1,1004 @@
+///
+///	@file yuvconv.c	@brief YUV plane conversion module
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup YuvConv The YUV plane conversion module.
+///
+///	Converts software decoded planar YUV frames into the NV12 layout
+///	of the textures.  Interleaves the U and V planes and reduces 10 bit
+///	samples to 8 bit, each in a single pass over the memory.
+///
+///	Also expands the 8 bit palette index bitmaps of non true color
+///	OSDs to ARGB.
+///
+///	All pitches are in bytes.
+///
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "yuvconv.h"
+
+///
+///	YUV conversion row kernels.
+///
+typedef struct _yuv_conv_kernel_
+{
+    const char *Name;			///< kernel name
+
+    int (*const Supported) (void);	///< cpu supports kernel
+    /// interleave row of U and V samples
+    void (*const Interleave) (uint8_t *, const uint8_t *, const uint8_t *,
+	int);
+    /// convert row of 10 bit samples to 8 bit
+    void (*const Depth) (uint8_t *, const uint16_t *, int);
+    /// interleave row of 10 bit U and V samples to 8 bit
+    void (*const InterleaveDepth) (uint8_t *, const uint16_t *,
+	const uint16_t *, int);
+    /// maximum sample of row
+    uint8_t(*const Max) (const uint8_t *, int);
+} YuvConvKernel;
+
+//----------------------------------------------------------------------------
+//	C reference kernels
+//----------------------------------------------------------------------------
+
+///
+///	C kernel always supported.
+///
+static int YuvConvSupportedC(void)
+{
+    return 1;
+}
+
+///
+///	Convert 10 bit sample to 8 bit, rounded and clipped.
+///
+///	@param x	10 bit sample
+///
+static inline uint8_t YuvConvSample(unsigned x)
+{
+    x = (x + 2) >> 2;
+    return x > 255 ? 255 : x;
+}
+
+///
+///	Interleave row of U and V samples.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+static void YuvConvInterleaveC(uint8_t * dst, const uint8_t * u,
+    const uint8_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+	dst[i * 2 + 0] = u[i];
+	dst[i * 2 + 1] = v[i];
+    }
+}
+
+///
+///	Convert row of 10 bit samples to 8 bit.
+///
+///	@param dst	8 bit output row
+///	@param src	10 bit input row
+///	@param n	number of samples
+///
+static void YuvConvDepthC(uint8_t * dst, const uint16_t * src, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+	dst[i] = YuvConvSample(src[i]);
+    }
+}
+
+///
+///	Interleave row of 10 bit U and V samples to 8 bit.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+static void YuvConvInterleaveDepthC(uint8_t * dst, const uint16_t * u,
+    const uint16_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+	dst[i * 2 + 0] = YuvConvSample(u[i]);
+	dst[i * 2 + 1] = YuvConvSample(v[i]);
+    }
+}
+
+///
+///	Expand row of palette indices to ARGB.
+///
+///	@param dst	ARGB output row
+///	@param src	index input row
+///	@param palette	256 entry ARGB palette
+///	@param n	number of pixels
+///
+static void YuvConvPaletteC(uint32_t * dst, const uint8_t * src,
+    const uint32_t * palette, int n)
+{
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+	dst[i + 0] = palette[src[i + 0]];
+	dst[i + 1] = palette[src[i + 1]];
+	dst[i + 2] = palette[src[i + 2]];
+	dst[i + 3] = palette[src[i + 3]];
+    }
+    for (; i < n; ++i) {
+	dst[i] = palette[src[i]];
+    }
+}
+
+///
+///	Get maximum sample of row.
+///
+///	@param src	input row
+///	@param n	number of samples
+///
+static uint8_t YuvConvMaxC(const uint8_t * src, int n)
+{
+    int i;
+    uint8_t max;
+
+    max = 0;
+    for (i = 0; i < n; ++i) {
+	if (src[i] > max) {
+	    max = src[i];
+	}
+    }
+    return max;
+}
+
+    /// C reference kernels
+static const YuvConvKernel YuvConvC = {
+    .Name = "C",
+    .Supported = YuvConvSupportedC,
+    .Interleave = YuvConvInterleaveC,
+    .Depth = YuvConvDepthC,
+    .InterleaveDepth = YuvConvInterleaveDepthC,
+    .Max = YuvConvMaxC,
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//----------------------------------------------------------------------------
+//	SSE2 kernels
+//----------------------------------------------------------------------------
+
+///
+///	Check if cpu supports SSE2.
+///
+static int YuvConvSupportedSse2(void)
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+///
+///	Convert 16 10 bit samples to 8 bit.
+///
+///	@param p	16 input samples
+///
+__attribute__ ((target("sse2")))
+static inline __m128i YuvConvDepth16Sse2(const uint16_t * p)
+{
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i a;
+    __m128i b;
+
+    a = _mm_loadu_si128((const __m128i *)p);
+    b = _mm_loadu_si128((const __m128i *)(p + 8));
+    a = _mm_srli_epi16(_mm_adds_epu16(a, two), 2);
+    b = _mm_srli_epi16(_mm_adds_epu16(b, two), 2);
+    return _mm_packus_epi16(a, b);
+}
+
+///
+///	Interleave row of U and V samples, 16 samples each step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+__attribute__ ((target("sse2")))
+static void YuvConvInterleaveSse2(uint8_t * dst, const uint8_t * u,
+    const uint8_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+	__m128i a;
+	__m128i b;
+
+	a = _mm_loadu_si128((const __m128i *)(u + i));
+	b = _mm_loadu_si128((const __m128i *)(v + i));
+	_mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi8(a, b));
+	_mm_storeu_si128((__m128i *) (dst + i * 2 + 16), _mm_unpackhi_epi8(a,
+		b));
+    }
+    YuvConvInterleaveC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Convert row of 10 bit samples to 8 bit, 16 samples each step.
+///
+///	@param dst	8 bit output row
+///	@param src	10 bit input row
+///	@param n	number of samples
+///
+__attribute__ ((target("sse2")))
+static void YuvConvDepthSse2(uint8_t * dst, const uint16_t * src, int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+	_mm_storeu_si128((__m128i *) (dst + i), YuvConvDepth16Sse2(src + i));
+    }
+    YuvConvDepthC(dst + i, src + i, n - i);
+}
+
+///
+///	Interleave row of 10 bit U and V samples to 8 bit, 16 samples each
+///	step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+__attribute__ ((target("sse2")))
+static void YuvConvInterleaveDepthSse2(uint8_t * dst, const uint16_t * u,
+    const uint16_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+	__m128i a;
+	__m128i b;
+
+	a = YuvConvDepth16Sse2(u + i);
+	b = YuvConvDepth16Sse2(v + i);
+	_mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi8(a, b));
+	_mm_storeu_si128((__m128i *) (dst + i * 2 + 16), _mm_unpackhi_epi8(a,
+		b));
+    }
+    YuvConvInterleaveDepthC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Get maximum of 16 samples.
+///
+///	@param m	16 samples
+///
+__attribute__ ((target("sse2")))
+static inline uint8_t YuvConvMax16Sse2(__m128i m)
+{
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+    m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+    return _mm_cvtsi128_si32(m);
+}
+
+///
+///	Get maximum sample of row, 16 samples each step.
+///
+///	@param src	input row
+///	@param n	number of samples
+///
+__attribute__ ((target("sse2")))
+static uint8_t YuvConvMaxSse2(const uint8_t * src, int n)
+{
+    __m128i m;
+    uint8_t max;
+    uint8_t tail;
+    int i;
+
+    m = _mm_setzero_si128();
+    for (i = 0; i + 16 <= n; i += 16) {
+	m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i *)(src + i)));
+    }
+    max = YuvConvMax16Sse2(m);
+    tail = YuvConvMaxC(src + i, n - i);
+    return max > tail ? max : tail;
+}
+
+    /// SSE2 kernels
+static const YuvConvKernel YuvConvSse2 = {
+    .Name = "SSE2",
+    .Supported = YuvConvSupportedSse2,
+    .Interleave = YuvConvInterleaveSse2,
+    .Depth = YuvConvDepthSse2,
+    .InterleaveDepth = YuvConvInterleaveDepthSse2,
+    // no gather, scalar table lookup is as fast
+    .Max = YuvConvMaxSse2,
+};
+
+//----------------------------------------------------------------------------
+//	AVX2 kernels
+//----------------------------------------------------------------------------
+
+///
+///	Check if cpu supports AVX2.
+///
+static int YuvConvSupportedAvx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+///
+///	Convert 32 10 bit samples to 8 bit.
+///
+///	@param p	32 input samples
+///
+__attribute__ ((target("avx2")))
+static inline __m256i YuvConvDepth32Avx2(const uint16_t * p)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+    __m256i a;
+    __m256i b;
+
+    a = _mm256_loadu_si256((const __m256i *)p);
+    b = _mm256_loadu_si256((const __m256i *)(p + 16));
+    a = _mm256_srli_epi16(_mm256_adds_epu16(a, two), 2);
+    b = _mm256_srli_epi16(_mm256_adds_epu16(b, two), 2);
+    // pack works in 128 bit lanes, restore sample order
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+///
+///	Interleave 32 U and 32 V samples and store them.
+///
+///	@param dst	UV output, 64 bytes
+///	@param a	U samples
+///	@param b	V samples
+///
+__attribute__ ((target("avx2")))
+static inline void YuvConvStore64Avx2(uint8_t * dst, __m256i a, __m256i b)
+{
+    __m256i lo;
+    __m256i hi;
+
+    // unpack works in 128 bit lanes, swap the middle halves
+    lo = _mm256_unpacklo_epi8(a, b);
+    hi = _mm256_unpackhi_epi8(a, b);
+    _mm256_storeu_si256((__m256i *) dst, _mm256_permute2x128_si256(lo, hi,
+	    0x20));
+    _mm256_storeu_si256((__m256i *) (dst + 32),
+	_mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+///
+///	Interleave row of U and V samples, 32 samples each step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+__attribute__ ((target("avx2")))
+static void YuvConvInterleaveAvx2(uint8_t * dst, const uint8_t * u,
+    const uint8_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+	YuvConvStore64Avx2(dst + i * 2,
+	    _mm256_loadu_si256((const __m256i *)(u + i)),
+	    _mm256_loadu_si256((const __m256i *)(v + i)));
+    }
+    YuvConvInterleaveC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Convert row of 10 bit samples to 8 bit, 32 samples each step.
+///
+///	@param dst	8 bit output row
+///	@param src	10 bit input row
+///	@param n	number of samples
+///
+__attribute__ ((target("avx2")))
+static void YuvConvDepthAvx2(uint8_t * dst, const uint16_t * src, int n)
+{
+    int i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+	_mm256_storeu_si256((__m256i *) (dst + i),
+	    YuvConvDepth32Avx2(src + i));
+    }
+    YuvConvDepthC(dst + i, src + i, n - i);
+}
+
+///
+///	Interleave row of 10 bit U and V samples to 8 bit, 32 samples each
+///	step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+__attribute__ ((target("avx2")))
+static void YuvConvInterleaveDepthAvx2(uint8_t * dst, const uint16_t * u,
+    const uint16_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 32 <= n; i += 32) {
+	YuvConvStore64Avx2(dst + i * 2, YuvConvDepth32Avx2(u + i),
+	    YuvConvDepth32Avx2(v + i));
+    }
+    YuvConvInterleaveDepthC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Get maximum sample of row, 32 samples each step.
+///
+///	@param src	input row
+///	@param n	number of samples
+///
+__attribute__ ((target("avx2")))
+static uint8_t YuvConvMaxAvx2(const uint8_t * src, int n)
+{
+    __m256i m;
+    __m128i r;
+    uint8_t max;
+    uint8_t tail;
+    int i;
+
+    m = _mm256_setzero_si256();
+    for (i = 0; i + 32 <= n; i += 32) {
+	m = _mm256_max_epu8(m, _mm256_loadu_si256((const __m256i *)(src +
+		    i)));
+    }
+    // reduce here, calling sse2 code would mix vex and legacy encoding
+    r = _mm_max_epu8(_mm256_castsi256_si128(m),
+	_mm256_extracti128_si256(m, 1));
+    r = _mm_max_epu8(r, _mm_srli_si128(r, 8));
+    r = _mm_max_epu8(r, _mm_srli_si128(r, 4));
+    r = _mm_max_epu8(r, _mm_srli_si128(r, 2));
+    r = _mm_max_epu8(r, _mm_srli_si128(r, 1));
+    max = _mm_cvtsi128_si32(r);
+    tail = YuvConvMaxC(src + i, n - i);
+    return max > tail ? max : tail;
+}
+
+    /// AVX2 kernels
+static const YuvConvKernel YuvConvAvx2 = {
+    .Name = "AVX2",
+    .Supported = YuvConvSupportedAvx2,
+    .Interleave = YuvConvInterleaveAvx2,
+    .Depth = YuvConvDepthAvx2,
+    .InterleaveDepth = YuvConvInterleaveDepthAvx2,
+    .Max = YuvConvMaxAvx2,
+};
+
+#endif
+
+#ifdef __ARM_NEON
+
+//----------------------------------------------------------------------------
+//	NEON kernels
+//----------------------------------------------------------------------------
+
+///
+///	NEON is selected at compile time.
+///
+static int YuvConvSupportedNeon(void)
+{
+    return 1;
+}
+
+///
+///	Interleave row of U and V samples, 16 samples each step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+static void YuvConvInterleaveNeon(uint8_t * dst, const uint8_t * u,
+    const uint8_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+	uint8x16x2_t uv;
+
+	uv.val[0] = vld1q_u8(u + i);
+	uv.val[1] = vld1q_u8(v + i);
+	vst2q_u8(dst + i * 2, uv);
+    }
+    YuvConvInterleaveC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Convert row of 10 bit samples to 8 bit, 16 samples each step.
+///
+///	@param dst	8 bit output row
+///	@param src	10 bit input row
+///	@param n	number of samples
+///
+static void YuvConvDepthNeon(uint8_t * dst, const uint16_t * src, int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+	// rounding saturating narrow: (x + 2) >> 2
+	vst1q_u8(dst + i, vcombine_u8(vqrshrn_n_u16(vld1q_u16(src + i), 2),
+		vqrshrn_n_u16(vld1q_u16(src + i + 8), 2)));
+    }
+    YuvConvDepthC(dst + i, src + i, n - i);
+}
+
+///
+///	Interleave row of 10 bit U and V samples to 8 bit, 8 samples each
+///	step.
+///
+///	@param dst	UV output row
+///	@param u	U input row
+///	@param v	V input row
+///	@param n	number of samples per plane
+///
+static void YuvConvInterleaveDepthNeon(uint8_t * dst, const uint16_t * u,
+    const uint16_t * v, int n)
+{
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+	uint8x8x2_t uv;
+
+	uv.val[0] = vqrshrn_n_u16(vld1q_u16(u + i), 2);
+	uv.val[1] = vqrshrn_n_u16(vld1q_u16(v + i), 2);
+	vst2_u8(dst + i * 2, uv);
+    }
+    YuvConvInterleaveDepthC(dst + i * 2, u + i, v + i, n - i);
+}
+
+///
+///	Get maximum sample of row, 16 samples each step.
+///
+///	@param src	input row
+///	@param n	number of samples
+///
+static uint8_t YuvConvMaxNeon(const uint8_t * src, int n)
+{
+    uint8x16_t m;
+    uint8x8_t r;
+    uint8_t max;
+    uint8_t tail;
+    int i;
+
+    m = vdupq_n_u8(0);
+    for (i = 0; i + 16 <= n; i += 16) {
+	m = vmaxq_u8(m, vld1q_u8(src + i));
+    }
+    r = vmax_u8(vget_low_u8(m), vget_high_u8(m));
+    r = vpmax_u8(r, r);
+    r = vpmax_u8(r, r);
+    r = vpmax_u8(r, r);
+    max = vget_lane_u8(r, 0);
+    tail = YuvConvMaxC(src + i, n - i);
+    return max > tail ? max : tail;
+}
+
+    /// NEON kernels
+static const YuvConvKernel YuvConvNeon = {
+    .Name = "NEON",
+    .Supported = YuvConvSupportedNeon,
+    .Interleave = YuvConvInterleaveNeon,
+    .Depth = YuvConvDepthNeon,
+    .InterleaveDepth = YuvConvInterleaveDepthNeon,
+    // no gather, scalar table lookup is as fast
+    .Max = YuvConvMaxNeon,
+};
+
+#endif
+
+    /// available kernels, best first
+static const YuvConvKernel *const YuvConvKernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    &YuvConvAvx2,
+    &YuvConvSse2,
+#endif
+#ifdef __ARM_NEON
+    &YuvConvNeon,
+#endif
+    &YuvConvC,
+};
+
+    /// selected kernels
+static const YuvConvKernel *YuvConvUsed = &YuvConvC;
+
+///
+///	Select fastest conversion kernels supported by the cpu.
+///
+void YuvConvInit(void)
+{
+    unsigned u;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+    for (u = 0; u < sizeof(YuvConvKernels) / sizeof(*YuvConvKernels); ++u) {
+	if (YuvConvKernels[u]->Supported()) {
+	    YuvConvUsed = YuvConvKernels[u];
+	    break;
+	}
+    }
+}
+
+///
+///	Interleave 8 bit U and V planes to NV12 UV plane.
+///
+///	For 4:2:2 input pass the double pitch, to use every second row.
+///
+///	@param dst		UV output plane
+///	@param dst_pitch	output pitch
+///	@param u		U input plane
+///	@param v		V input plane
+///	@param src_pitch	input pitch of U and V plane
+///	@param width		samples per row of each input plane
+///	@param height		number of rows
+///
+void YuvConvInterleave(uint8_t * dst, int dst_pitch, const uint8_t * u,
+    const uint8_t * v, int src_pitch, int width, int height)
+{
+    int y;
+
+    for (y = 0; y < height; ++y) {
+	YuvConvUsed->Interleave(dst, u, v, width);
+	dst += dst_pitch;
+	u += src_pitch;
+	v += src_pitch;
+    }
+}
+
+///
+///	Convert 10 bit plane to 8 bit plane.
+///
+///	@param dst		8 bit output plane
+///	@param dst_pitch	output pitch
+///	@param src		10 bit input plane
+///	@param src_pitch	input pitch
+///	@param width		samples per row
+///	@param height		number of rows
+///
+void YuvConvDepth(uint8_t * dst, int dst_pitch, const uint16_t * src,
+    int src_pitch, int width, int height)
+{
+    int y;
+
+    for (y = 0; y < height; ++y) {
+	YuvConvUsed->Depth(dst, src, width);
+	dst += dst_pitch;
+	src = (const uint16_t *)((const uint8_t *)src + src_pitch);
+    }
+}
+
+///
+///	Interleave 10 bit U and V planes to 8 bit NV12 UV plane.
+///
+///	@param dst		UV output plane
+///	@param dst_pitch	output pitch
+///	@param u		U input plane
+///	@param v		V input plane
+///	@param src_pitch	input pitch of U and V plane
+///	@param width		samples per row of each input plane
+///	@param height		number of rows
+///
+void YuvConvInterleaveDepth(uint8_t * dst, int dst_pitch,
+    const uint16_t * u, const uint16_t * v, int src_pitch, int width,
+    int height)
+{
+    int y;
+
+    for (y = 0; y < height; ++y) {
+	YuvConvUsed->InterleaveDepth(dst, u, v, width);
+	dst += dst_pitch;
+	u = (const uint16_t *)((const uint8_t *)u + src_pitch);
+	v = (const uint16_t *)((const uint8_t *)v + src_pitch);
+    }
+}
+
+///
+///	Expand 8 bit palette index plane to ARGB.
+///
+///	The table lookup is scalar for all kernels, gathers are not
+///	faster than the unrolled C loop.
+///
+///	@param dst		ARGB output plane
+///	@param dst_pitch	output pitch
+///	@param src		index input plane
+///	@param src_pitch	input pitch
+///	@param palette		256 entry ARGB palette
+///	@param width		pixels per row
+///	@param height		number of rows
+///
+void YuvConvPalette(uint32_t * dst, int dst_pitch, const uint8_t * src,
+    int src_pitch, const uint32_t * palette, int width, int height)
+{
+    int y;
+
+    for (y = 0; y < height; ++y) {
+	YuvConvPaletteC(dst, src, palette, width);
+	dst = (uint32_t *) ((uint8_t *) dst + dst_pitch);
+	src += src_pitch;
+    }
+}
+
+///
+///	Get maximum sample of 8 bit row.
+///
+///	@param src	input row
+///	@param n	number of samples
+///
+///	@returns largest sample value.
+///
+int YuvConvMax(const uint8_t * src, int n)
+{
+    return YuvConvUsed->Max(src, n);
+}
+
+#ifdef YUVCONV_TEST
+
+//----------------------------------------------------------------------------
+//	Test
+//----------------------------------------------------------------------------
+
+#include <time.h>
+
+///
+///	Get time in ms.
+///
+static double YuvConvTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+///
+///	Old per byte conversion of CpuRenderFrame, for comparison.
+///
+///	@param out	UV output plane
+///	@param u	U input plane
+///	@param v	V input plane
+///	@param pitch	input pitch
+///	@param height	frame height
+///
+static void YuvConvOld(uint8_t * out, const uint8_t * u, const uint8_t * v,
+    int pitch, int height)
+{
+    int i;
+
+    for (i = 0; i < pitch * height / 2; i++) {
+	memcpy(out + i * 2, u + i, 1);
+	memcpy(out + i * 2 + 1, v + i, 1);
+    }
+}
+
+///
+///	Benchmark one frame size with all supported kernels.
+///
+///	@param name	frame size name
+///	@param width	frame width
+///	@param height	frame height
+///
+static void YuvConvBench(const char *name, int width, int height)
+{
+    uint8_t *u8;
+    uint8_t *v8;
+    uint16_t *y16;
+    uint16_t *u16;
+    uint16_t *v16;
+    uint8_t *ref;
+    uint8_t *out;
+    uint8_t *idx;
+    uint32_t palette[256];
+    int cw;
+    int ch;
+    int pitch;
+    int loops;
+    unsigned k;
+    int i;
+    double t;
+
+    cw = width / 2;
+    ch = height / 2;
+    pitch = (width + 63) & ~63;		// ffmpeg like padded pitch
+    // 4:2:2 chroma has full height
+    u8 = malloc(pitch / 2 * height);
+    v8 = malloc(pitch / 2 * height);
+    y16 = malloc(pitch * 2 * height);
+    u16 = malloc(pitch * ch);
+    v16 = malloc(pitch * ch);
+    // row padding is never written, must compare equal
+    ref = calloc(pitch * 4, height);
+    out = calloc(pitch * 4, height);
+    idx = malloc(pitch * height);
+    for (i = 0; i < pitch * height; ++i) {
+	idx[i] = random();
+    }
+    for (i = 0; i < 256; ++i) {
+	palette[i] = random();
+    }
+    for (i = 0; i < pitch / 2 * height; ++i) {
+	u8[i] = random();
+	v8[i] = random();
+    }
+    for (i = 0; i < pitch * height; ++i) {
+	y16[i] = random() & 0x3FF;
+    }
+    for (i = 0; i < pitch / 2 * ch; ++i) {
+	u16[i] = random() & 0x3FF;
+	v16[i] = random() & 0x3FF;
+    }
+    loops = 1 + 200 * 1920 * 1080 / (width * height);
+
+    printf("%s %dx%d, ms per frame:\n", name, width, height);
+
+    t = YuvConvTime();
+    for (i = 0; i < loops; ++i) {
+	YuvConvOld(out, u8, v8, pitch / 2, height);
+    }
+    printf("  old  : 420 %6.3f\n", (YuvConvTime() - t) / loops);
+    memset(out, 0, pitch * 4 * height);	// page in the ARGB size
+
+    t = YuvConvTime();
+    for (i = 0; i < loops; ++i) {
+	YuvConvPalette((uint32_t *) out, pitch * 4, idx, pitch, palette,
+	    width, height);
+    }
+    printf("  all  : palette %6.3f\n", (YuvConvTime() - t) / loops);
+    // old conversion and palette write the padding of the NV12 rows
+    memset(out, 0, pitch * 4 * height);
+
+    for (k = 0; k < sizeof(YuvConvKernels) / sizeof(*YuvConvKernels); ++k) {
+	double t420;
+	double t422;
+	double t10;
+	double tmax;
+
+	YuvConvUsed = YuvConvKernels[k];
+	if (!YuvConvUsed->Supported()) {
+	    continue;
+	}
+	// check against C kernels
+	if (YuvConvUsed != &YuvConvC) {
+	    const YuvConvKernel *kernel;
+
+	    kernel = YuvConvUsed;
+	    YuvConvUsed = &YuvConvC;
+	    YuvConvInterleave(ref, pitch, u8, v8, pitch / 2, cw, ch);
+	    YuvConvDepth(ref + pitch * ch, width, y16, pitch * 2, width,
+		height / 2);
+	    YuvConvUsed = kernel;
+	    YuvConvInterleave(out, pitch, u8, v8, pitch / 2, cw, ch);
+	    YuvConvDepth(out + pitch * ch, width, y16, pitch * 2, width,
+		height / 2);
+	    if (memcmp(ref, out, pitch * ch + width * height / 2)) {
+		printf("  %-5s: results differ from C\n", kernel->Name);
+	    }
+	    YuvConvUsed = &YuvConvC;
+	    YuvConvInterleaveDepth(ref, pitch, u16, v16, pitch, cw, ch);
+	    YuvConvUsed = kernel;
+	    YuvConvInterleaveDepth(out, pitch, u16, v16, pitch, cw, ch);
+	    if (memcmp(ref, out, pitch * ch)) {
+		printf("  %-5s: 10 bit results differ from C\n", kernel->Name);
+	    }
+	    for (i = 0; i < height; ++i) {
+		if (YuvConvC.Max(idx + i * pitch, width - i % 33)
+		    != kernel->Max(idx + i * pitch, width - i % 33)
+		    || YuvConvC.Max(u8 + i, i % 67)
+		    != kernel->Max(u8 + i, i % 67)) {
+		    printf("  %-5s: max results differ from C\n",
+			kernel->Name);
+		    break;
+		}
+	    }
+	}
+
+	t = YuvConvTime();
+	for (i = 0; i < loops; ++i) {
+	    YuvConvInterleave(out, pitch, u8, v8, pitch / 2, cw, ch);
+	}
+	t420 = (YuvConvTime() - t) / loops;
+
+	t = YuvConvTime();
+	for (i = 0; i < loops; ++i) {
+	    YuvConvInterleave(out, pitch, u8, v8, pitch, cw, ch);
+	}
+	t422 = (YuvConvTime() - t) / loops;
+
+	t = YuvConvTime();
+	for (i = 0; i < loops; ++i) {
+	    YuvConvDepth(out, pitch, y16, pitch * 2, width, height);
+	    YuvConvInterleaveDepth(out, pitch, u16, v16, pitch, cw, ch);
+	}
+	t10 = (YuvConvTime() - t) / loops;
+
+	t = YuvConvTime();
+	for (i = 0; i < loops; ++i) {
+	    int y;
+
+	    for (y = 0; y < height; ++y) {
+		YuvConvMax(idx + y * pitch, width);
+	    }
+	}
+	tmax = (YuvConvTime() - t) / loops;
+
+	printf("  %-5s: 420 %6.3f 422 %6.3f 420p10 %6.3f max %6.3f\n",
+	    YuvConvUsed->Name, t420, t422, t10, tmax);
+    }
+
+    free(u8);
+    free(v8);
+    free(y16);
+    free(u16);
+    free(v16);
+    free(ref);
+    free(out);
+    free(idx);
+}
+
+///
+///	Main entry point.
+///
+///	Benchmarks the kernels with SD, HD and UHD frame sizes.
+///
+///	@param argc	number of arguments
+///	@param argv	arguments vector
+///
+int main(int argc, char *const argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    srandom(1);
+    YuvConvBench("576i", 720, 576);
+    YuvConvBench("1080i", 1920, 1080);
+    YuvConvBench("2160p", 3840, 2160);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,45 @@
+///
+///	@file yuvconv.h	@brief YUV plane conversion module header file
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+/// @addtogroup YuvConv
+/// @{
+
+    /// select fastest conversion kernels for the cpu
+extern void YuvConvInit(void);
+
+    /// interleave 8 bit U and V planes to NV12 UV plane
+extern void YuvConvInterleave(uint8_t *, int, const uint8_t *,
+    const uint8_t *, int, int, int);
+
+    /// convert 10 bit plane to 8 bit plane
+extern void YuvConvDepth(uint8_t *, int, const uint16_t *, int, int, int);
+
+    /// interleave 10 bit U and V planes to 8 bit NV12 UV plane
+extern void YuvConvInterleaveDepth(uint8_t *, int, const uint16_t *,
+    const uint16_t *, int, int, int);
+
+    /// expand 8 bit palette index plane to ARGB
+extern void YuvConvPalette(uint32_t *, int, const uint8_t *, int,
+    const uint32_t *, int, int);
+
+    /// get maximum sample of 8 bit row
+extern int YuvConvMax(const uint8_t *, int);
+
+/// @}